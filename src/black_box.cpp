@@ -0,0 +1,171 @@
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#if IBM
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "black_box.h"
+
+const char BLACK_BOX_MAGIC[8] = { 'X', 'P', 'A', 'T', 'B', 'B', 'X', '\0' };
+
+const size_t BLACK_BOX_FILE_SIZE = sizeof(BlackBoxHeader) + sizeof(BlackBoxEntry) * BLACK_BOX_CAPACITY;
+
+static BlackBoxHeader* g_header = nullptr;
+static BlackBoxEntry* g_entries = nullptr;
+
+#if IBM
+static HANDLE g_file = INVALID_HANDLE_VALUE;
+static HANDLE g_mapping = nullptr;
+#else
+static int g_file = -1;
+#endif
+
+// Create the file at its full size and map it read/write
+static void* MapFile(const char* path) {
+#if IBM
+    g_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (g_file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    g_mapping = CreateFileMappingA(g_file, nullptr, PAGE_READWRITE, 0, (DWORD)BLACK_BOX_FILE_SIZE, nullptr);
+    void* view = g_mapping ? MapViewOfFile(g_mapping, FILE_MAP_WRITE, 0, 0, BLACK_BOX_FILE_SIZE) : nullptr;
+    if (!view) {
+        if (g_mapping) {
+            CloseHandle(g_mapping);
+            g_mapping = nullptr;
+        }
+        CloseHandle(g_file);
+        g_file = INVALID_HANDLE_VALUE;
+    }
+    return view;
+#else
+    g_file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (g_file < 0) {
+        return nullptr;
+    }
+    void* view = MAP_FAILED;
+    if (ftruncate(g_file, (off_t)BLACK_BOX_FILE_SIZE) == 0) {
+        view = mmap(nullptr, BLACK_BOX_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, g_file, 0);
+    }
+    if (view == MAP_FAILED) {
+        close(g_file);
+        g_file = -1;
+        return nullptr;
+    }
+    return view;
+#endif
+}
+
+static void UnmapFile(void* view) {
+#if IBM
+    FlushViewOfFile(view, 0);
+    UnmapViewOfFile(view);
+    CloseHandle(g_mapping);
+    CloseHandle(g_file);
+    g_mapping = nullptr;
+    g_file = INVALID_HANDLE_VALUE;
+#else
+    msync(view, BLACK_BOX_FILE_SIZE, MS_ASYNC);
+    munmap(view, BLACK_BOX_FILE_SIZE);
+    close(g_file);
+    g_file = -1;
+#endif
+}
+
+bool BlackBoxOpen(const char* path, const char* previous_path) {
+    BlackBoxClose();
+
+    // Keep the last session; remove() first because rename() does not
+    // replace an existing file on Windows
+    remove(previous_path);
+    rename(path, previous_path);
+
+    void* view = MapFile(path);
+    if (!view) {
+        return false;
+    }
+
+    g_header = static_cast<BlackBoxHeader*>(view);
+    g_entries = reinterpret_cast<BlackBoxEntry*>(g_header + 1);
+    memcpy(g_header->magic, BLACK_BOX_MAGIC, sizeof(g_header->magic));
+    g_header->version = BLACK_BOX_VERSION;
+    g_header->capacity = BLACK_BOX_CAPACITY;
+    g_header->entry_size = sizeof(BlackBoxEntry);
+    g_header->max_engines = MAX_ENGINES;
+    g_header->next = 0;
+    return true;
+}
+
+void BlackBoxClose(void) {
+    if (!g_header) {
+        return;
+    }
+    UnmapFile(g_header);
+    g_header = nullptr;
+    g_entries = nullptr;
+}
+
+// Slot for the next entry. Committed by CommitEntry() once filled in.
+static BlackBoxEntry* NextEntry(void) {
+    return &g_entries[g_header->next % BLACK_BOX_CAPACITY];
+}
+
+static void CommitEntry(void) {
+    // Order the entry stores before the index store, so the file never
+    // claims an entry that was not fully written
+    std::atomic_thread_fence(std::memory_order_release);
+    g_header->next++;
+}
+
+void BlackBoxRecordSample(const FlightLogSample& sample) {
+    if (!g_header) {
+        return;
+    }
+    BlackBoxEntry* entry = NextEntry();
+    entry->sample_time = sample.sample_time;
+    entry->kind = BLACK_BOX_SAMPLE;
+    entry->num_engines = sample.num_engines;
+    entry->flags = sample.flags;
+    entry->variable = sample.variable;
+    entry->target_rpm = sample.target_rpm;
+    entry->value = sample.dt;
+    for (int i = 0; i < sample.num_engines; i++) {
+        entry->rpm[i] = sample.rpm[i];
+        entry->throttle[i] = sample.throttle[i];
+        entry->commanded_throttle[i] = sample.commanded_throttle[i];
+    }
+    CommitEntry();
+}
+
+void BlackBoxRecordEvent(BlackBoxKind kind, float sample_time, float target_rpm, float value) {
+    if (!g_header) {
+        return;
+    }
+    BlackBoxEntry* entry = NextEntry();
+    entry->sample_time = sample_time;
+    entry->kind = (uint8_t)kind;
+    entry->num_engines = 0;
+    entry->flags = 0;
+    entry->variable = 0;
+    entry->target_rpm = target_rpm;
+    entry->value = value;
+    CommitEntry();
+}
+
+void BlackBoxFlush(void) {
+    if (!g_header) {
+        return;
+    }
+#if IBM
+    FlushViewOfFile(g_header, 0);
+#else
+    msync(g_header, BLACK_BOX_FILE_SIZE, MS_ASYNC);
+#endif
+}
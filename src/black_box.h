@@ -0,0 +1,77 @@
+#ifndef BLACK_BOX_H
+#define BLACK_BOX_H
+
+#include <stdint.h>
+
+#include "flight_log.h"
+
+// Crash-survivable black box: a fixed-size memory-mapped file holding a
+// circular buffer of the most recent controller samples and events.
+//
+// Entries are written in place with plain stores, so recording costs no
+// syscalls, and because the pages belong to the file the OS writes them
+// back even if X-Plane dies.
+
+const uint32_t BLACK_BOX_VERSION = 1;
+const uint32_t BLACK_BOX_CAPACITY = 4096;   // Entries: about a minute at 60 fps
+
+// Entry kinds. Target events carry the old target in target_rpm and the new
+// one in value, both in the units given.
+enum BlackBoxKind {
+    BLACK_BOX_SAMPLE = 0,           // Flight loop tick (value: dt)
+    BLACK_BOX_ENGAGE,               // Autothrottle engaged
+    BLACK_BOX_DISENGAGE,            // Autothrottle disengaged
+    BLACK_BOX_TARGET,               // Engine target changed (old and new target, control units)
+    BLACK_BOX_THROTTLE_STEP,        // Large commanded throttle step (value: largest step)
+    BLACK_BOX_PLANE_CRASHED,        // XPLM_MSG_PLANE_CRASHED
+    BLACK_BOX_MODE,                 // Hold mode changed (value: new AutothrottleMode)
+    BLACK_BOX_SPEED_TARGET,         // Speed target changed (old and new target, knots or Mach)
+    BLACK_BOX_VARIABLE,             // Engine variable changed (value: new variable)
+    BLACK_BOX_PROP_TARGET,          // Prop RPM target changed (old and new target, RPM)
+    BLACK_BOX_PILOT_OVERRIDE,       // Throttles moved while engaged (value: 1 taken over, 0 disengaged)
+    BLACK_BOX_KIND_COUNT
+};
+
+struct BlackBoxEntry {
+    float sample_time;      // Plugin time (seconds)
+    uint8_t kind;           // BlackBoxKind
+    uint8_t num_engines;    // Engines in the arrays below (samples only)
+    uint8_t flags;          // FLIGHT_LOG_* flags (samples only)
+    uint8_t variable;       // Engine variable (samples only)
+    float target_rpm;       // Engine target at the time (control units); the old target for target events
+    float value;            // Event argument, see BlackBoxKind
+    float rpm[MAX_ENGINES];
+    float throttle[MAX_ENGINES];
+    float commanded_throttle[MAX_ENGINES];
+};
+
+// File layout: this header followed by BLACK_BOX_CAPACITY entries. The
+// newest entry is at (next - 1) % capacity; next is only advanced after the
+// entry is complete, so a reader never sees a half-written newest entry.
+struct BlackBoxHeader {
+    char magic[8];          // "XPATBBX\0"
+    uint32_t version;       // BLACK_BOX_VERSION
+    uint32_t capacity;      // Entries in the ring
+    uint32_t entry_size;    // sizeof(BlackBoxEntry)
+    uint32_t max_engines;   // MAX_ENGINES of the writer
+    uint64_t next;          // Total entries written
+};
+
+// Create and map the black box file. An existing file at path is first
+// moved to previous_path, so a restart after a crash keeps the crashed
+// session. Returns false if the file cannot be created or mapped;
+// recording calls are then no-ops.
+bool BlackBoxOpen(const char* path, const char* previous_path);
+
+// Unmap and close the file
+void BlackBoxClose(void);
+
+// Append a flight loop sample or an event. Stores to mapped memory only.
+void BlackBoxRecordSample(const FlightLogSample& sample);
+void BlackBoxRecordEvent(BlackBoxKind kind, float sample_time, float target_rpm, float value);
+
+// Ask the OS to start writing dirty pages back now, e.g. after a crash
+// message. Asynchronous; not needed for normal operation.
+void BlackBoxFlush(void);
+
+#endif // BLACK_BOX_H
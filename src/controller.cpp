@@ -0,0 +1,439 @@
+#include <cmath>
+
+#include "controller.h"
+
+PidGains DefaultPidGains(void) {
+    PidGains gains;
+    gains.kp = 0.0006f;
+    gains.ki = 0.0007f;
+    gains.kd = 0.00002f;
+    gains.kt = 2.0f;
+    gains.derivative_tau = 0.2f;
+    gains.output_min = 0.0f;
+    gains.output_max = 1.0f;
+    gains.rate_limit = 0.5f;
+    gains.kp_scale = 1.0f;
+    gains.ki_scale = 1.0f;
+    return gains;
+}
+
+SpeedGains DefaultSpeedGains(void) {
+    SpeedGains gains;
+    gains.kp = 40.0f;
+    gains.ki = 3.0f;
+    gains.rpm_min = 1000.0f;
+    gains.rpm_max = 2500.0f;
+    gains.rate_limit = 150.0f;
+    return gains;
+}
+
+PropGains DefaultPropGains(void) {
+    PropGains gains;
+    gains.kp = 0.0002f;
+    gains.ki = 0.0008f;
+    gains.rate_limit = 0.5f;
+    gains.lever_feedforward = 0.0011f;
+    gains.decoupling = 0.00015f;
+    gains.governor_tau = 1.5f;
+    return gains;
+}
+
+ActuatorLimits DefaultActuatorLimits(void) {
+    ActuatorLimits limits;
+    limits.rate_limit = 0.5f;
+    limits.accel_limit = 4.0f;
+    return limits;
+}
+
+// Put the levers at rest where they are
+static void ActuatorReset(ThrottleActuator* actuator, const float* position, int num_engines) {
+    for (int i = 0; i < num_engines; i++) {
+        actuator->position[i] = position[i];
+        actuator->velocity[i] = 0.0f;
+    }
+}
+
+// Move each lever towards its desired position for one frame. The speed
+// aimed for is the fastest the lever can still brake from before the
+// target, so it ramps up, cruises at the rate limit and ramps down. A
+// lever that would pass the target stops on it.
+static void ActuatorStep(ThrottleActuator* actuator, const float* desired, int num_engines, float dt, const ActuatorLimits& limits) {
+    if (dt <= 0.0f) {
+        return;
+    }
+
+    const float max_change = limits.accel_limit * dt;
+    for (int i = 0; i < num_engines; i++) {
+        const float error = desired[i] - actuator->position[i];
+        const float distance = fabsf(error);
+        const float braking_speed = sqrtf(2.0f * limits.accel_limit * distance);
+        const float speed = fminf(fminf(limits.rate_limit, braking_speed), distance / dt);
+        const float wanted = copysignf(speed, error);
+
+        float velocity = actuator->velocity[i];
+        velocity = fminf(fmaxf(wanted, velocity - max_change), velocity + max_change);
+        float position = actuator->position[i] + velocity * dt;
+        if ((desired[i] - position) * error <= 0.0f) {
+            position = desired[i];
+            velocity = 0.0f;
+        }
+        actuator->position[i] = position;
+        actuator->velocity[i] = velocity;
+    }
+}
+
+void PidEngage(PidBank* bank, float setpoint, const float* measurement, const float* current_output, int num_engines, const PidGains& gains) {
+    bank->num_engines = num_engines;
+    for (int i = 0; i < num_engines; i++) {
+        // Choose the integral so P + I reproduces the current throttle
+        float error = setpoint - measurement[i];
+        bank->integral[i] = current_output[i] - gains.kp * error;
+        bank->derivative[i] = 0.0f;
+        bank->prev_measurement[i] = measurement[i];
+        bank->output[i] = current_output[i];
+    }
+}
+
+void PidUpdate(PidBank* bank, float setpoint, const float* measurement, float dt, const PidGains& gains) {
+    if (dt <= 0.0f) {
+        return;
+    }
+
+    const float inv_dt = 1.0f / dt;
+    const float alpha = dt / (gains.derivative_tau + dt);
+    const float max_step = gains.rate_limit * dt;
+    const int num_engines = bank->num_engines;
+
+    for (int i = 0; i < num_engines; i++) {
+        float pv = measurement[i];
+        float error = setpoint - pv;
+
+        // Derivative on measurement avoids a kick on setpoint changes
+        float raw_derivative = -gains.kd * (pv - bank->prev_measurement[i]) * inv_dt;
+        float derivative = bank->derivative[i] + alpha * (raw_derivative - bank->derivative[i]);
+
+        float unsaturated = gains.kp * error + bank->integral[i] + derivative;
+        float saturated = fminf(fmaxf(unsaturated, gains.output_min), gains.output_max);
+
+        // Rate limit relative to the last command
+        float previous = bank->output[i];
+        float output = fminf(fmaxf(saturated, previous - max_step), previous + max_step);
+
+        // Back-calculation: bleed the integrator by however much the
+        // limiters cut the output, then clamp it to the output range
+        float integral = bank->integral[i] + (gains.ki * error + gains.kt * (output - unsaturated)) * dt;
+        integral = fminf(fmaxf(integral, gains.output_min), gains.output_max);
+
+        bank->integral[i] = integral;
+        bank->derivative[i] = derivative;
+        bank->prev_measurement[i] = pv;
+        bank->output[i] = output;
+    }
+}
+
+// Closed-loop time constant floor for the SIMC rules (s), so a near-zero
+// dead time does not ask for an arbitrarily fast loop
+const float MIN_CLOSED_LOOP_TIME = 0.3f;
+
+// Tuned kp and ki stay within this factor of the base gains
+const float MAX_GAIN_RATIO = 4.0f;
+
+// Time constant with which adaptive gains follow the plant estimate (s)
+const float GAIN_BLEND_TIME = 2.0f;
+
+PidGains PlantTunedGains(const PlantModel& model, const PidGains& base) {
+    if (!model.valid) {
+        return base;
+    }
+
+    // SIMC PI: kc = tau / (K (tau_c + L)), Ti = min(tau, 4 (tau_c + L)),
+    // with the closed-loop time constant tau_c set to the dead time
+    float closed_loop = fmaxf(model.dead_time, MIN_CLOSED_LOOP_TIME) + model.dead_time;
+    float kp = model.time_constant / (model.gain * closed_loop);
+    float ki = kp / fminf(model.time_constant, 4.0f * closed_loop);
+
+    PidGains gains = base;
+    gains.kp = fminf(fmaxf(kp, base.kp / MAX_GAIN_RATIO), base.kp * MAX_GAIN_RATIO);
+    gains.ki = fminf(fmaxf(ki, base.ki / MAX_GAIN_RATIO), base.ki * MAX_GAIN_RATIO);
+    return gains;
+}
+
+// Gains for this step: the base gains, or with adaptation on, the running
+// gains eased towards those tuned for the current plant estimate. The
+// plant is tuned for against the unscheduled gains and the schedule's
+// factors applied on top, so the schedule shapes adapted gains as it does
+// fixed ones.
+static void UpdateGains(Autothrottle* autothrottle, const PidGains& base, float dt) {
+    if (!autothrottle->adaptive) {
+        autothrottle->gains = base;
+        return;
+    }
+    PidGains unscheduled = base;
+    unscheduled.kp = base.kp / base.kp_scale;
+    unscheduled.ki = base.ki / base.ki_scale;
+    PidGains tuned = PlantTunedGains(PlantEstimatorModel(autothrottle->estimator), unscheduled);
+    tuned.kp *= base.kp_scale;
+    tuned.ki *= base.ki_scale;
+    PidGains& gains = autothrottle->gains;
+    if (gains.kp <= 0.0f || gains.ki <= 0.0f) {
+        gains = base; // First step
+    }
+    float alpha = dt / (GAIN_BLEND_TIME + dt);
+    float kp = gains.kp + alpha * (tuned.kp - gains.kp);
+    float ki = gains.ki + alpha * (tuned.ki - gains.ki);
+    gains = base;
+    gains.kp = kp;
+    gains.ki = ki;
+}
+
+// Below this Mach number the IAS per Mach ratio is meaningless
+const float MIN_MACH = 0.05f;
+
+float SpeedErrorKt(const EngineState& state) {
+    if (state.mode == AUTOTHROTTLE_MODE_IAS) {
+        return state.target_ias_kt - state.indicated_airspeed_kt;
+    }
+    if (state.mode == AUTOTHROTTLE_MODE_MACH && state.mach > MIN_MACH) {
+        return (state.target_mach - state.mach) * state.indicated_airspeed_kt / state.mach;
+    }
+    return 0.0f;
+}
+
+static float MeanRpm(const EngineState& state) {
+    float sum = 0.0f;
+    for (int i = 0; i < state.num_engines; i++) {
+        sum += state.rpm[i];
+    }
+    return (state.num_engines > 0) ? sum / state.num_engines : 0.0f;
+}
+
+// True if every engine's last command is at this throttle limit
+static bool ThrottleAtLimit(const PidBank& bank, float limit) {
+    int at_limit = 1;
+    for (int i = 0; i < bank.num_engines; i++) {
+        at_limit &= bank.output[i] == limit;
+    }
+    return at_limit != 0;
+}
+
+// Start the outer loop so its first RPM target is start_rpm
+static void SpeedLoopEngage(SpeedLoop* loop, float start_rpm, float error, const SpeedGains& gains) {
+    float rpm = fminf(fmaxf(roundf(start_rpm), gains.rpm_min), gains.rpm_max);
+    loop->integral = rpm - gains.kp * error;
+    loop->output = rpm;
+}
+
+// One outer loop step, returning the RPM target. The integral only runs
+// while neither the RPM target limits nor the inner loop's throttle limits
+// stop the target moving the way the error asks, so a speed the engine
+// cannot make does not wind it up.
+static float SpeedLoopUpdate(SpeedLoop* loop, float error, float dt, bool throttle_high, bool throttle_low, const SpeedGains& gains) {
+    float unsaturated = gains.kp * error + loop->integral;
+    float saturated = fminf(fmaxf(unsaturated, gains.rpm_min), gains.rpm_max);
+    float max_step = gains.rate_limit * dt;
+    float output = fminf(fmaxf(saturated, loop->output - max_step), loop->output + max_step);
+
+    bool held_up = error > 0.0f && (throttle_high || output < unsaturated);
+    bool held_down = error < 0.0f && (throttle_low || output > unsaturated);
+    if (!held_up && !held_down) {
+        loop->integral = fminf(fmaxf(loop->integral + gains.ki * error * dt, gains.rpm_min), gains.rpm_max);
+    }
+    loop->output = output;
+    return output;
+}
+
+// PID gains of the prop lever loop: PI on the lever over its full travel
+static PidGains PropPidGains(const PropGains& prop_gains) {
+    PidGains gains = DefaultPidGains();
+    gains.kp = prop_gains.kp;
+    gains.ki = prop_gains.ki;
+    gains.kd = 0.0f;
+    gains.rate_limit = prop_gains.rate_limit;
+    return gains;
+}
+
+// Forget the prop loop's state, so the next prop target engages it afresh
+static void PropReset(Autothrottle* autothrottle) {
+    autothrottle->prop_engaged = false;
+    autothrottle->prop_target = 0.0f;
+    autothrottle->prop_governed = 0.0f;
+}
+
+// One step of the prop loop and its decoupler. Only the lever loop needs
+// the prop inputs; the throttle feedforward follows the target alone.
+static void PropStep(Autothrottle* autothrottle, const EngineState& state, float dt, const PropGains& prop_gains) {
+    const float target = (float)state.target_prop_rpm;
+    if (target <= 0.0f) {
+        PropReset(autothrottle);
+        return;
+    }
+    if (autothrottle->prop_target <= 0.0f) {
+        autothrottle->prop_target = target;
+        autothrottle->prop_governed = target;
+    }
+    const float target_change = target - autothrottle->prop_target;
+    const float previous_governed = autothrottle->prop_governed;
+    autothrottle->prop_target = target;
+    autothrottle->prop_governed += dt / (prop_gains.governor_tau + dt) * (target - previous_governed);
+
+    // Raising the RPM lowers manifold pressure, so open the throttle with it
+    const float decoupling = prop_gains.decoupling * (autothrottle->prop_governed - previous_governed);
+    for (int i = 0; i < autothrottle->bank.num_engines; i++) {
+        autothrottle->bank.integral[i] += decoupling;
+    }
+
+    if (!state.prop_valid) {
+        autothrottle->prop_engaged = false;
+        return;
+    }
+    PidBank& prop = autothrottle->prop;
+    const PidGains gains = PropPidGains(prop_gains);
+    if (!autothrottle->prop_engaged || prop.num_engines != state.num_engines) {
+        PidEngage(&prop, autothrottle->prop_governed, state.prop_rpm, state.prop_lever, state.num_engines, gains);
+        autothrottle->prop_engaged = true;
+        return;
+    }
+    // The feedforward moves the last command too, so the rate limit and
+    // its anti-windup do not eat into it
+    const float lever_change = prop_gains.lever_feedforward * target_change;
+    for (int i = 0; i < prop.num_engines; i++) {
+        prop.integral[i] += lever_change;
+        prop.output[i] = fminf(fmaxf(prop.output[i] + lever_change, gains.output_min), gains.output_max);
+    }
+    // While the governor is still following a target change the loop sees
+    // no error, so the lever holds the feedforward position rather than
+    // chasing the governor's response
+    if (fabsf(target - autothrottle->prop_governed) > RPM_TOLERANCE) {
+        float on_target[MAX_ENGINES];
+        for (int i = 0; i < prop.num_engines; i++) {
+            on_target[i] = autothrottle->prop_governed;
+        }
+        PidUpdate(&prop, autothrottle->prop_governed, on_target, dt, gains);
+    } else {
+        PidUpdate(&prop, autothrottle->prop_governed, state.prop_rpm, dt, gains);
+    }
+}
+
+AutothrottleAction AutothrottleStep(Autothrottle* autothrottle, const EngineState& state, bool enabled, const PidGains& gains,
+                                    const SpeedGains& speed_gains, const PropGains& prop_gains,
+                                    const ActuatorLimits& actuator_limits) {
+    // Check if we have all required datarefs
+    const bool inputs_valid = state.rpm_valid && state.throttle_valid;
+    const float dt = state.dt;
+    const float previous_kp = autothrottle->gains.kp;
+
+    // Learn from every tick, including the pilot flying the throttle
+    if (inputs_valid) {
+        PlantEstimatorUpdate(&autothrottle->estimator, state);
+        UpdateGains(autothrottle, gains, dt);
+    }
+
+    if (!enabled) {
+        autothrottle->engaged = false; // Re-engage bumplessly next time
+        PropReset(autothrottle);
+        return AUTOTHROTTLE_OFF;
+    }
+    if (!inputs_valid) {
+        return AUTOTHROTTLE_OFF;
+    }
+
+    const bool speed_mode = state.mode != AUTOTHROTTLE_MODE_ENGINE;
+    const float speed_error = SpeedErrorKt(state);
+    PidBank& bank = autothrottle->bank;
+
+    if (!autothrottle->engaged || bank.num_engines != state.num_engines) {
+        if (speed_mode) {
+            SpeedLoopEngage(&autothrottle->speed, MeanRpm(state), speed_error, speed_gains);
+        }
+        autothrottle->mode = state.mode;
+        autothrottle->rpm_setpoint = speed_mode ? autothrottle->speed.output : (float)state.target_rpm;
+        PidEngage(&bank, autothrottle->rpm_setpoint, state.rpm, state.throttle, state.num_engines, autothrottle->gains);
+        ActuatorReset(&autothrottle->actuator, state.throttle, state.num_engines);
+        autothrottle->engaged = true;
+        autothrottle->override_armed = true;
+        PropReset(autothrottle);
+        PropStep(autothrottle, state, dt, prop_gains);
+        return AUTOTHROTTLE_ENGAGED;
+    }
+
+    // Someone else moved a lever: take the throttles from where they were
+    // left rather than fight over them
+    float deviation = 0.0f;
+    for (int i = 0; i < state.num_engines; i++) {
+        deviation = fmaxf(deviation, fabsf(state.throttle[i] - autothrottle->actuator.position[i]));
+    }
+    if (autothrottle->override_armed && deviation > OVERRIDE_TRIP) {
+        PidEngage(&bank, autothrottle->rpm_setpoint, state.rpm, state.throttle, state.num_engines, autothrottle->gains);
+        ActuatorReset(&autothrottle->actuator, state.throttle, state.num_engines);
+        autothrottle->override_armed = false;
+        return AUTOTHROTTLE_OVERRIDDEN;
+    }
+    autothrottle->override_armed = autothrottle->override_armed || deviation < OVERRIDE_ARM;
+
+    // A switch into a speed mode carries on from the RPM target held so far
+    if (state.mode != autothrottle->mode) {
+        if (speed_mode) {
+            SpeedLoopEngage(&autothrottle->speed, autothrottle->rpm_setpoint, speed_error, speed_gains);
+        }
+        autothrottle->mode = state.mode;
+    }
+    // The outer loop's RPM target is rounded to whole RPM, so a recorded
+    // target replays exactly through the RPM loop alone
+    if (speed_mode) {
+        autothrottle->rpm_setpoint = roundf(SpeedLoopUpdate(&autothrottle->speed, speed_error, dt,
+                                                     ThrottleAtLimit(bank, autothrottle->gains.output_max),
+                                                     ThrottleAtLimit(bank, autothrottle->gains.output_min), speed_gains));
+    } else {
+        autothrottle->rpm_setpoint = (float)state.target_rpm;
+    }
+    const float target_rpm = autothrottle->rpm_setpoint;
+
+    // Move the proportional change in a retune into the integral, so the
+    // command does not jump with the gains
+    const float kp_change = previous_kp - autothrottle->gains.kp;
+    if (kp_change != 0.0f) {
+        for (int i = 0; i < state.num_engines; i++) {
+            bank.integral[i] += kp_change * (target_rpm - bank.prev_measurement[i]);
+        }
+    }
+
+    // The levers never move faster than the actuator allows, so neither
+    // may the command
+    PidGains step_gains = autothrottle->gains;
+    step_gains.rate_limit = fminf(step_gains.rate_limit, actuator_limits.rate_limit);
+
+    PropStep(autothrottle, state, dt, prop_gains);
+    PidUpdate(&bank, target_rpm, state.rpm, dt, step_gains);
+    ActuatorStep(&autothrottle->actuator, bank.output, bank.num_engines, dt, actuator_limits);
+
+    // Back-calculate the levers' lag behind the command as well, so the
+    // integrator does not wind up while the actuator accelerates
+    for (int i = 0; i < bank.num_engines; i++) {
+        float integral = bank.integral[i] + step_gains.kt * (autothrottle->actuator.position[i] - bank.output[i]) * dt;
+        bank.integral[i] = fminf(fmaxf(integral, step_gains.output_min), step_gains.output_max);
+    }
+    return AUTOTHROTTLE_COMMAND;
+}
+
+bool AutothrottleOutOfTolerance(const Autothrottle& autothrottle, const EngineState& state) {
+    const float target_rpm = autothrottle.rpm_setpoint;
+    int out_of_tolerance = fabsf(SpeedErrorKt(state)) > SPEED_TOLERANCE_KT;
+    for (int i = 0; i < state.num_engines; i++) {
+        out_of_tolerance |= fabsf(target_rpm - state.rpm[i]) > RPM_TOLERANCE;
+    }
+    if (autothrottle.prop_engaged) {
+        for (int i = 0; i < state.num_engines; i++) {
+            out_of_tolerance |= fabsf((float)state.target_prop_rpm - state.prop_rpm[i]) > RPM_TOLERANCE;
+        }
+    }
+    return out_of_tolerance != 0;
+}
+
+bool AutothrottleActuating(const Autothrottle& autothrottle) {
+    const ThrottleActuator& actuator = autothrottle.actuator;
+    int actuating = 0;
+    for (int i = 0; i < autothrottle.bank.num_engines; i++) {
+        actuating |= actuator.position[i] != autothrottle.bank.output[i] || actuator.velocity[i] != 0.0f;
+    }
+    return autothrottle.engaged && actuating != 0;
+}
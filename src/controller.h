@@ -0,0 +1,189 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include "plant_estimator.h"
+#include "plugin.h"
+
+// PID gains and limits for the RPM -> throttle loop
+struct PidGains {
+    float kp;               // Proportional gain (throttle per RPM)
+    float ki;               // Integral gain (throttle per RPM-second)
+    float kd;               // Derivative gain on measurement (throttle per RPM/s)
+    float kt;               // Back-calculation anti-windup gain (1/s)
+    float derivative_tau;   // Derivative low-pass filter time constant (s)
+    float output_min;       // Throttle lower limit
+    float output_max;       // Throttle upper limit
+    float rate_limit;       // Maximum throttle change per second
+    float kp_scale;         // Gain schedule factor already in kp (1 unscheduled)
+    float ki_scale;         // Gain schedule factor already in ki (1 unscheduled)
+};
+
+// Default gains for a fixed-pitch piston single
+PidGains DefaultPidGains(void);
+
+// Per-engine PID state stored as parallel arrays so all engines are
+// updated in one pass
+struct PidBank {
+    float integral[MAX_ENGINES];            // Integral term (throttle units)
+    float derivative[MAX_ENGINES];          // Filtered derivative term (throttle units)
+    float prev_measurement[MAX_ENGINES];
+    float output[MAX_ENGINES];              // Last commanded throttle
+    int num_engines;
+};
+
+// Initialise the controller from the current throttle and RPM so engaging
+// does not move the throttle (bumpless transfer)
+void PidEngage(PidBank* bank, float setpoint, const float* measurement, const float* current_output, int num_engines, const PidGains& gains);
+
+// Run one controller step for every engine. dt is the elapsed time in
+// seconds since the previous step. Results are left in bank->output.
+void PidUpdate(PidBank* bank, float setpoint, const float* measurement, float dt, const PidGains& gains);
+
+// PI gains for a fitted plant by the SIMC rules, with the derivative,
+// anti-windup and limits taken from base. kp and ki stay within a fixed
+// factor of base; an invalid model returns base unchanged.
+PidGains PlantTunedGains(const PlantModel& model, const PidGains& base);
+
+// Hold modes: the engine loop alone, or an outer airspeed loop that sets
+// the engine loop's target
+enum AutothrottleMode {
+    AUTOTHROTTLE_MODE_ENGINE = 0, // Hold target_rpm
+    AUTOTHROTTLE_MODE_IAS,      // Hold target_ias_kt
+    AUTOTHROTTLE_MODE_MACH,     // Hold target_mach
+    AUTOTHROTTLE_MODE_COUNT
+};
+
+// PI gains and limits for the outer airspeed -> RPM target loop. Mach
+// errors are converted to knots at the current IAS so one set of gains
+// serves both speed modes.
+struct SpeedGains {
+    float kp;               // Proportional gain (RPM per knot)
+    float ki;               // Integral gain (RPM per knot-second)
+    float rpm_min;          // RPM target range
+    float rpm_max;
+    float rate_limit;       // Maximum RPM target change per second
+};
+
+// Default speed gains for a fixed-pitch piston single
+SpeedGains DefaultSpeedGains(void);
+
+// Outer loop state
+struct SpeedLoop {
+    float integral;         // Integral term (RPM)
+    float output;           // RPM target of the last step
+};
+
+// Gains for the constant-speed prop mode's second loop, which holds prop
+// RPM with the prop lever while the throttle holds manifold pressure. The
+// governor already turns a lever position into an RPM, so a target change
+// moves the lever by the governor's slope at once, and the PI loop only
+// trims what that misses. It tracks the target through a lag matching the
+// governor, so it does not chase the governor's own response and hunt
+// against it. The same lagged target feeds forward to the throttle, which
+// opens as the RPM rises rather than after the manifold pressure drops.
+struct PropGains {
+    float kp;               // Proportional gain (lever per RPM)
+    float ki;               // Integral gain (lever per RPM-second)
+    float rate_limit;       // Maximum lever change per second
+    float lever_feedforward;    // Lever per RPM of target change (inverse governor slope)
+    float decoupling;       // Throttle per RPM of governed RPM change
+    float governor_tau;     // Governor response time to a lever change (s)
+};
+
+// Default prop gains for a constant-speed piston single
+PropGains DefaultPropGains(void);
+
+// Limits of the actuator stage between the control law and the levers.
+// The control law's output is the desired throttle; the actuator moves the
+// lever towards it every frame, accelerating and braking within
+// accel_limit and never faster than rate_limit, so a step in the command
+// becomes a smooth ramp instead of a jump in one frame.
+struct ActuatorLimits {
+    float rate_limit;       // Maximum lever speed (throttle per second)
+    float accel_limit;      // Maximum lever acceleration (throttle per second^2)
+};
+
+// Default actuator limits: the PID's own rate limit, reached in an eighth
+// of a second
+ActuatorLimits DefaultActuatorLimits(void);
+
+// Lever state of the actuator stage, per engine
+struct ThrottleActuator {
+    float position[MAX_ENGINES];    // Lever position written last
+    float velocity[MAX_ENGINES];    // Throttle per second
+};
+
+// Autothrottle control law: engages the PID bank bumplessly and then steps
+// it once per tick. Free of XPLM calls, so recorded traces can be replayed
+// offline through exactly the code the plugin runs.
+struct Autothrottle {
+    PidBank bank;           // bank.output is the desired throttle
+    ThrottleActuator actuator;  // Moves the levers towards bank.output
+    bool engaged;           // Bank initialised from the current throttle
+    bool adaptive;          // Retune kp/ki from the plant estimate
+    PlantEstimator estimator;   // Fed on every valid tick, engaged or not
+    PidGains gains;         // Gains of the last step
+    int mode;               // AutothrottleMode of the last step
+    SpeedLoop speed;        // Outer loop, run in the speed modes
+    float rpm_setpoint;     // RPM target of the last step
+    PidBank prop;           // Prop lever loop, run while the state has a prop target
+    bool prop_engaged;      // prop initialised from the current lever
+    float prop_target;      // Prop target of the last step (RPM), 0 without
+    float prop_governed;    // Prop target lagged by the governor response (RPM)
+    bool override_armed;    // A lever moved from the command is reported
+};
+
+// Pilot override detection. A lever more than OVERRIDE_TRIP from the last
+// command was moved by someone else: the pilot, a hardware axis or another
+// plugin. The detector then disarms until every lever is back within
+// OVERRIDE_ARM of the command, so one movement is reported once rather than
+// every tick the levers are fought over.
+const float OVERRIDE_TRIP = 0.05f;
+const float OVERRIDE_ARM = 0.01f;
+
+enum AutothrottleAction {
+    AUTOTHROTTLE_OFF = 0,   // Disengaged or inputs invalid; nothing to write
+    AUTOTHROTTLE_ENGAGED,   // Engaged this tick; actuator.position holds the current throttle
+    AUTOTHROTTLE_COMMAND,   // actuator.position holds a new throttle command to write,
+                            // and with prop_engaged, prop.output a lever command
+    AUTOTHROTTLE_OVERRIDDEN,    // A lever was moved from the command; the loop carries on
+                                // from where it was left, in actuator.position
+};
+
+// Run the control law for one sampled tick. Disengaging (enabled false)
+// resets the controller so the next engage is bumpless; a change in engine
+// count re-engages. With adaptive set, kp and ki move smoothly towards the
+// gains tuned for the estimated plant, scaled by gains' schedule factors;
+// otherwise gains is used as is. In
+// the speed modes the outer loop sets the RPM target from the airspeed
+// error, starting from the current RPM on engage or a change of mode. With
+// a prop target the lever loop runs too, engaging bumplessly once the prop
+// inputs are valid; the decoupler only needs the target, so a replay
+// without prop data still reproduces the throttle. The actuator then moves
+// the levers towards the control law's output within actuator_limits. A
+// lever moved away from the command is reported as an override instead of
+// being fought.
+AutothrottleAction AutothrottleStep(Autothrottle* autothrottle, const EngineState& state, bool enabled, const PidGains& gains,
+                                    const SpeedGains& speed_gains, const PropGains& prop_gains,
+                                    const ActuatorLimits& actuator_limits);
+
+// Band the autothrottle holds each engine within (RPM either side of target)
+const float RPM_TOLERANCE = 15.0f;
+
+// Band the speed modes hold the airspeed within (knots either side of target)
+const float SPEED_TOLERANCE_KT = 2.0f;
+
+// Airspeed error in knots for the state's speed mode (Mach errors scaled
+// by IAS per Mach); 0 in engine mode or without a usable Mach number
+float SpeedErrorKt(const EngineState& state);
+
+// True if any engine is outside the RPM tolerance of the last RPM target,
+// or of its prop target, or in a speed mode, the airspeed is outside its
+// tolerance
+bool AutothrottleOutOfTolerance(const Autothrottle& autothrottle, const EngineState& state);
+
+// True while the actuator has not yet brought every lever to rest on the
+// control law's output, so it needs stepping every frame
+bool AutothrottleActuating(const Autothrottle& autothrottle);
+
+#endif // CONTROLLER_H
@@ -0,0 +1,208 @@
+#ifndef DATAREF_H
+#define DATAREF_H
+
+#include <type_traits>
+
+#include "XPLMDataAccess.h"
+
+// Typed accessor for an X-Plane dataref.
+//
+// The handle and storage type are resolved once in Bind() and the matching
+// XPLMGetData*/XPLMSetData* call is picked at that point, so reads and writes
+// on the hot path are a single call with no XPLMGetDataRefTypes branching.
+// Bind() again after XPLM_MSG_PLANE_LOADED or XPLM_MSG_DATAREFS_ADDED.
+//
+// Scalar Get()/Set() on an array dataref access element 0; GetArray() on a
+// scalar dataref returns the single value.
+template <typename T>
+class DataRef {
+public:
+    explicit DataRef(const char* name) : m_name(name) {}
+
+    // Resolve the handle and storage type. Returns false if the dataref
+    // does not exist or has no usable type.
+    bool Bind(void) {
+        Invalidate();
+        XPLMDataRef handle = XPLMFindDataRef(m_name);
+        if (!handle) {
+            return false;
+        }
+
+        XPLMDataTypeID type = XPLMGetDataRefTypes(handle);
+        if (type & xplmType_FloatArray) {
+            m_get = GetFloatArray;
+            m_set = SetFloatArray;
+            m_get_array = GetArrayFloatArray;
+            m_set_array = SetArrayFloatArray;
+        } else if (type & xplmType_Float) {
+            m_get = GetFloat;
+            m_set = SetFloat;
+        } else if (type & xplmType_Double) {
+            m_get = GetDouble;
+            m_set = SetDouble;
+        } else if (type & xplmType_Int) {
+            m_get = GetInt;
+            m_set = SetInt;
+        } else if (type & xplmType_IntArray) {
+            m_get = GetIntArray;
+            m_set = SetIntArray;
+            m_get_array = GetArrayIntArray;
+            m_set_array = SetArrayIntArray;
+        } else {
+            return false;
+        }
+
+        m_handle = handle;
+        m_writable = XPLMCanWriteDataRef(handle) != 0;
+        return true;
+    }
+
+    void Invalidate(void) {
+        m_handle = nullptr;
+        m_writable = false;
+        m_get = nullptr;
+        m_set = nullptr;
+        m_get_array = nullptr;
+        m_set_array = nullptr;
+    }
+
+    bool IsValid(void) const { return m_handle != nullptr; }
+    bool IsWritable(void) const { return m_writable; }
+    bool IsArray(void) const { return m_get_array != nullptr; }
+    const char* Name(void) const { return m_name; }
+
+    T Get(void) const {
+        return m_handle ? m_get(m_handle) : T();
+    }
+
+    void Set(T value) const {
+        if (m_writable) {
+            m_set(m_handle, value);
+        }
+    }
+
+    // Read up to count elements starting at offset. Returns the number read.
+    int GetArray(T* out, int offset, int count) const {
+        if (!m_handle || count <= 0) {
+            return 0;
+        }
+        if (!m_get_array) {
+            if (offset != 0) {
+                return 0;
+            }
+            out[0] = m_get(m_handle);
+            return 1;
+        }
+        return m_get_array(m_handle, out, offset, count);
+    }
+
+    // Write count elements starting at offset.
+    void SetArray(const T* values, int offset, int count) const {
+        if (!m_writable || count <= 0) {
+            return;
+        }
+        if (!m_set_array) {
+            if (offset == 0) {
+                m_set(m_handle, values[0]);
+            }
+            return;
+        }
+        m_set_array(m_handle, values, offset, count);
+    }
+
+private:
+    typedef T (*Getter)(XPLMDataRef);
+    typedef void (*Setter)(XPLMDataRef, T);
+    typedef int (*ArrayGetter)(XPLMDataRef, T*, int, int);
+    typedef void (*ArraySetter)(XPLMDataRef, const T*, int, int);
+
+    // Conversion buffer size for array access when T differs from the storage type
+    static const int CHUNK = 16;
+
+    static T GetFloat(XPLMDataRef ref) { return static_cast<T>(XPLMGetDataf(ref)); }
+    static T GetDouble(XPLMDataRef ref) { return static_cast<T>(XPLMGetDatad(ref)); }
+    static T GetInt(XPLMDataRef ref) { return static_cast<T>(XPLMGetDatai(ref)); }
+    static T GetFloatArray(XPLMDataRef ref) {
+        float value = 0.0f;
+        XPLMGetDatavf(ref, &value, 0, 1);
+        return static_cast<T>(value);
+    }
+    static T GetIntArray(XPLMDataRef ref) {
+        int value = 0;
+        XPLMGetDatavi(ref, &value, 0, 1);
+        return static_cast<T>(value);
+    }
+
+    static void SetFloat(XPLMDataRef ref, T value) { XPLMSetDataf(ref, static_cast<float>(value)); }
+    static void SetDouble(XPLMDataRef ref, T value) { XPLMSetDatad(ref, static_cast<double>(value)); }
+    static void SetInt(XPLMDataRef ref, T value) { XPLMSetDatai(ref, static_cast<int>(value)); }
+    static void SetFloatArray(XPLMDataRef ref, T value) {
+        float element = static_cast<float>(value);
+        XPLMSetDatavf(ref, &element, 0, 1);
+    }
+    static void SetIntArray(XPLMDataRef ref, T value) {
+        int element = static_cast<int>(value);
+        XPLMSetDatavi(ref, &element, 0, 1);
+    }
+
+    template <typename S, typename Fn>
+    static int ReadConverted(XPLMDataRef ref, T* out, int offset, int count, Fn read) {
+        S buffer[CHUNK];
+        int total = 0;
+        while (total < count) {
+            int want = (count - total < CHUNK) ? count - total : CHUNK;
+            int got = read(ref, buffer, offset + total, want);
+            for (int i = 0; i < got; i++) {
+                out[total + i] = static_cast<T>(buffer[i]);
+            }
+            total += got;
+            if (got < want) {
+                break;
+            }
+        }
+        return total;
+    }
+
+    template <typename S, typename Fn>
+    static void WriteConverted(XPLMDataRef ref, const T* values, int offset, int count, Fn write) {
+        S buffer[CHUNK];
+        for (int done = 0; done < count; done += CHUNK) {
+            int n = (count - done < CHUNK) ? count - done : CHUNK;
+            for (int i = 0; i < n; i++) {
+                buffer[i] = static_cast<S>(values[done + i]);
+            }
+            write(ref, buffer, offset + done, n);
+        }
+    }
+
+    static int GetArrayFloatArray(XPLMDataRef ref, T* out, int offset, int count) {
+        if constexpr (std::is_same<T, float>::value) {
+            return XPLMGetDatavf(ref, out, offset, count);
+        } else {
+            return ReadConverted<float>(ref, out, offset, count, XPLMGetDatavf);
+        }
+    }
+    static int GetArrayIntArray(XPLMDataRef ref, T* out, int offset, int count) {
+        return ReadConverted<int>(ref, out, offset, count, XPLMGetDatavi);
+    }
+    static void SetArrayFloatArray(XPLMDataRef ref, const T* values, int offset, int count) {
+        if constexpr (std::is_same<T, float>::value) {
+            XPLMSetDatavf(ref, const_cast<float*>(values), offset, count);
+        } else {
+            WriteConverted<float>(ref, values, offset, count, XPLMSetDatavf);
+        }
+    }
+    static void SetArrayIntArray(XPLMDataRef ref, const T* values, int offset, int count) {
+        WriteConverted<int>(ref, values, offset, count, XPLMSetDatavi);
+    }
+
+    const char* m_name;
+    XPLMDataRef m_handle = nullptr;
+    bool m_writable = false;
+    Getter m_get = nullptr;
+    Setter m_set = nullptr;
+    ArrayGetter m_get_array = nullptr;
+    ArraySetter m_set_array = nullptr;
+};
+
+#endif // DATAREF_H
@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "flight_log.h"
+
+const char FLIGHT_LOG_MAGIC[8] = { 'X', 'P', 'A', 'T', 'L', 'O', 'G', '\0' };
+
+// Fixed part of a record on disk
+struct FlightLogRecordHeader {
+    float sample_time;
+    float dt;
+    float target_rpm;
+    uint8_t num_engines;
+    uint8_t flags;
+    uint8_t variable;               // Zero (RPM) in older logs
+    uint8_t reserved;
+    float density_altitude_ft;      // Version 2 on
+    float indicated_airspeed_kt;
+    float target_prop_rpm;          // Version 3 on
+};
+static_assert(sizeof(FlightLogRecordHeader) == 28, "Record header layout changed");
+
+// Record header sizes of version 1 logs, which end at reserved, and of
+// version 2 logs, which end at the airspeed
+const size_t FLIGHT_LOG_V1_RECORD_HEADER = 16;
+const size_t FLIGHT_LOG_V2_RECORD_HEADER = 24;
+
+bool FlightLogWriteHeader(FILE* file) {
+    FlightLogHeader header;
+    memcpy(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_LOG_VERSION;
+    header.max_engines = MAX_ENGINES;
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool FlightLogWriteSample(FILE* file, const FlightLogSample& sample) {
+    FlightLogRecordHeader record;
+    record.sample_time = sample.sample_time;
+    record.dt = sample.dt;
+    record.target_rpm = sample.target_rpm;
+    record.num_engines = (sample.num_engines < MAX_ENGINES) ? sample.num_engines : MAX_ENGINES;
+    record.flags = sample.flags;
+    record.variable = sample.variable;
+    record.reserved = 0;
+    record.density_altitude_ft = sample.density_altitude_ft;
+    record.indicated_airspeed_kt = sample.indicated_airspeed_kt;
+    record.target_prop_rpm = sample.target_prop_rpm;
+
+    // Interleave per engine so a record is one contiguous write
+    float values[MAX_ENGINES * 3];
+    for (int i = 0; i < record.num_engines; i++) {
+        values[i * 3 + 0] = sample.rpm[i];
+        values[i * 3 + 1] = sample.throttle[i];
+        values[i * 3 + 2] = sample.commanded_throttle[i];
+    }
+    return fwrite(&record, sizeof(record), 1, file) == 1 &&
+           fwrite(values, sizeof(float) * 3, record.num_engines, file) == record.num_engines;
+}
+
+bool FlightLogReadHeader(FILE* file, FlightLogHeader* header) {
+    if (fread(header, sizeof(*header), 1, file) != 1) {
+        return false;
+    }
+    return memcmp(header->magic, FLIGHT_LOG_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version >= 1 && header->version <= FLIGHT_LOG_VERSION;
+}
+
+bool FlightLogReadSample(FILE* file, const FlightLogHeader& header, FlightLogSample* sample) {
+    FlightLogRecordHeader record = {};
+    size_t record_size = (header.version == 1) ? FLIGHT_LOG_V1_RECORD_HEADER :
+                         (header.version == 2) ? FLIGHT_LOG_V2_RECORD_HEADER : sizeof(record);
+    if (fread(&record, record_size, 1, file) != 1 || record.num_engines > MAX_ENGINES) {
+        return false;
+    }
+
+    float values[MAX_ENGINES * 3];
+    if (fread(values, sizeof(float) * 3, record.num_engines, file) != record.num_engines) {
+        return false;
+    }
+
+    sample->sample_time = record.sample_time;
+    sample->dt = record.dt;
+    sample->target_rpm = record.target_rpm;
+    sample->num_engines = record.num_engines;
+    sample->flags = record.flags;
+    sample->variable = record.variable;
+    sample->density_altitude_ft = record.density_altitude_ft;
+    sample->indicated_airspeed_kt = record.indicated_airspeed_kt;
+    sample->target_prop_rpm = record.target_prop_rpm;
+    for (int i = 0; i < record.num_engines; i++) {
+        sample->rpm[i] = values[i * 3 + 0];
+        sample->throttle[i] = values[i * 3 + 1];
+        sample->commanded_throttle[i] = values[i * 3 + 2];
+    }
+    return true;
+}
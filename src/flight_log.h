@@ -0,0 +1,68 @@
+#ifndef FLIGHT_LOG_H
+#define FLIGHT_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "plugin.h"
+
+// Binary flight log written by the recorder and read by offline tools.
+//
+// The file is a FlightLogHeader followed by one record per flight loop
+// tick: a fixed 28-byte record header (time, dt, target, engine count,
+// flags, engine variable, density altitude, indicated airspeed, prop
+// target) and then the controlled variable, throttle and commanded
+// throttle for each engine, so a single-engine aircraft costs 40 bytes per
+// tick rather than a full MAX_ENGINES sample. The target and controlled
+// variable are in the control core's units (RPM, or for turbines the
+// indicator scaled to a similar range; see EngineState). Values are
+// stored in native byte order. Version 1 records lack the
+// density altitude and airspeed, and versions before 3 the prop target;
+// they read back as zero.
+
+const uint32_t FLIGHT_LOG_VERSION = 3;
+
+struct FlightLogHeader {
+    char magic[8];          // "XPATLOG\0"
+    uint32_t version;       // FLIGHT_LOG_VERSION
+    uint32_t max_engines;   // MAX_ENGINES of the writer
+};
+
+// Sample flags
+const uint8_t FLIGHT_LOG_ENGAGED = 1 << 0;     // Autothrottle engaged
+const uint8_t FLIGHT_LOG_RPM_VALID = 1 << 1;   // RPM dataref resolved
+const uint8_t FLIGHT_LOG_THROTTLE_VALID = 1 << 2; // Throttle dataref resolved
+const uint8_t FLIGHT_LOG_ADAPTIVE = 1 << 3;    // Gains retuned from the plant estimate
+const uint8_t FLIGHT_LOG_SPEED_HOLD = 1 << 4;  // Target set by the IAS or Mach loop
+
+// One flight loop tick
+struct FlightLogSample {
+    float sample_time;      // Plugin time of the sample (seconds)
+    float dt;               // Time since the previous sample (seconds)
+    float target_rpm;       // Target (control units)
+    uint8_t num_engines;    // Engines recorded
+    uint8_t flags;          // FLIGHT_LOG_* flags
+    uint8_t variable;       // Engine variable held by the plugin (0 is RPM)
+    float density_altitude_ft;      // Flight condition (version 2)
+    float indicated_airspeed_kt;
+    float target_prop_rpm;  // Constant-speed prop target (RPM), 0 without (version 3)
+    float rpm[MAX_ENGINES];                 // Sampled controlled variable per engine (control units)
+    float throttle[MAX_ENGINES];            // Sampled throttle per engine
+    float commanded_throttle[MAX_ENGINES];  // Throttle written per engine
+};
+
+// Write the file header. Returns false on a write error.
+bool FlightLogWriteHeader(FILE* file);
+
+// Write one sample record. Returns false on a write error.
+bool FlightLogWriteSample(FILE* file, const FlightLogSample& sample);
+
+// Read and check the file header. Returns false if this is not a flight log
+// of a supported version.
+bool FlightLogReadHeader(FILE* file, FlightLogHeader* header);
+
+// Read the next sample of a log with this header. Returns false at the end
+// of the file or on a truncated record.
+bool FlightLogReadSample(FILE* file, const FlightLogHeader& header, FlightLogSample* sample);
+
+#endif // FLIGHT_LOG_H
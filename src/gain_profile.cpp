@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gain_profile.h"
+
+struct GainField {
+    const char* name;
+    float PidGains::* field;
+};
+
+const GainField GAIN_FIELDS[] = {
+    { "kp", &PidGains::kp },
+    { "ki", &PidGains::ki },
+    { "kd", &PidGains::kd },
+    { "kt", &PidGains::kt },
+    { "derivative_tau", &PidGains::derivative_tau },
+    { "rate_limit", &PidGains::rate_limit },
+};
+const int GAIN_FIELD_COUNT = sizeof(GAIN_FIELDS) / sizeof(GAIN_FIELDS[0]);
+
+struct SpeedGainField {
+    const char* name;
+    float SpeedGains::* field;
+};
+
+const SpeedGainField SPEED_GAIN_FIELDS[] = {
+    { "speed_kp", &SpeedGains::kp },
+    { "speed_ki", &SpeedGains::ki },
+    { "speed_rpm_min", &SpeedGains::rpm_min },
+    { "speed_rpm_max", &SpeedGains::rpm_max },
+    { "speed_rate_limit", &SpeedGains::rate_limit },
+};
+const int SPEED_GAIN_FIELD_COUNT = sizeof(SPEED_GAIN_FIELDS) / sizeof(SPEED_GAIN_FIELDS[0]);
+
+struct PropGainField {
+    const char* name;
+    float PropGains::* field;
+};
+
+const PropGainField PROP_GAIN_FIELDS[] = {
+    { "prop_kp", &PropGains::kp },
+    { "prop_ki", &PropGains::ki },
+    { "prop_rate_limit", &PropGains::rate_limit },
+    { "prop_lever_feedforward", &PropGains::lever_feedforward },
+    { "prop_decoupling", &PropGains::decoupling },
+    { "prop_governor_tau", &PropGains::governor_tau },
+};
+const int PROP_GAIN_FIELD_COUNT = sizeof(PROP_GAIN_FIELDS) / sizeof(PROP_GAIN_FIELDS[0]);
+
+struct ActuatorField {
+    const char* name;
+    float ActuatorLimits::* field;
+};
+
+const ActuatorField ACTUATOR_FIELDS[] = {
+    { "throttle_rate_limit", &ActuatorLimits::rate_limit },
+    { "throttle_accel_limit", &ActuatorLimits::accel_limit },
+};
+const int ACTUATOR_FIELD_COUNT = sizeof(ACTUATOR_FIELDS) / sizeof(ACTUATOR_FIELDS[0]);
+
+GainProfile DefaultGainProfile(void) {
+    GainProfile profile = {};
+    profile.gains = DefaultPidGains();
+    profile.speed = DefaultSpeedGains();
+    profile.prop = DefaultPropGains();
+    profile.actuator = DefaultActuatorLimits();
+    return profile;
+}
+
+// Strip leading and trailing whitespace in place
+static char* Trim(char* text) {
+    while (*text == ' ' || *text == '\t') {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+// Parse a whitespace-separated list of up to max numbers. Returns the count,
+// or -1 if the text holds anything else or too many values.
+static int ParseList(const char* text, float* values, int max) {
+    int count = 0;
+    while (*text) {
+        char* end = nullptr;
+        float value = strtof(text, &end);
+        if (end == text || count == max) {
+            return -1;
+        }
+        values[count++] = value;
+        text = end;
+        while (*text == ' ' || *text == '\t') {
+            text++;
+        }
+    }
+    return count;
+}
+
+static bool Ascending(const float* values, int count) {
+    for (int i = 1; i < count; i++) {
+        if (!(values[i] > values[i - 1])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Schedule rows as read, before the axes are known to be complete
+struct ScheduleRows {
+    float kp[GAIN_SCHEDULE_MAX_POINTS][GAIN_SCHEDULE_MAX_POINTS];
+    float ki[GAIN_SCHEDULE_MAX_POINTS][GAIN_SCHEDULE_MAX_POINTS];
+    int kp_rows;
+    int ki_rows;
+    int kp_lengths[GAIN_SCHEDULE_MAX_POINTS];
+    int ki_lengths[GAIN_SCHEDULE_MAX_POINTS];
+};
+
+// Check the rows against the axes and fill in the cells
+static bool BuildSchedule(const ScheduleRows& rows, GainSchedule* schedule) {
+    const int altitudes = schedule->altitude_count;
+    const int airspeeds = schedule->airspeed_count;
+    if (altitudes == 0 && airspeeds == 0 && rows.kp_rows == 0 && rows.ki_rows == 0) {
+        return true; // No schedule
+    }
+    if (altitudes == 0 || airspeeds == 0 ||
+        !Ascending(schedule->altitudes_ft, altitudes) || !Ascending(schedule->airspeeds_kt, airspeeds) ||
+        (rows.kp_rows != 0 && rows.kp_rows != altitudes) || (rows.ki_rows != 0 && rows.ki_rows != altitudes)) {
+        return false;
+    }
+
+    for (int a = 0; a < altitudes; a++) {
+        if ((rows.kp_rows && rows.kp_lengths[a] != airspeeds) || (rows.ki_rows && rows.ki_lengths[a] != airspeeds)) {
+            return false;
+        }
+        for (int s = 0; s < airspeeds; s++) {
+            GainScheduleCell& cell = schedule->cells[a * airspeeds + s];
+            cell.kp_scale = rows.kp_rows ? rows.kp[a][s] : 1.0f;
+            cell.ki_scale = rows.ki_rows ? rows.ki[a][s] : 1.0f;
+            if (!(cell.kp_scale > 0.0f) || !(cell.ki_scale > 0.0f)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Apply one "name = value" line. Returns false for an unknown key or a bad
+// value.
+static bool ParseLine(const char* name, const char* value, GainProfile* profile, ScheduleRows* rows) {
+    GainSchedule& schedule = profile->schedule;
+    if (!strcmp(name, "schedule_density_altitude")) {
+        schedule.altitude_count = ParseList(value, schedule.altitudes_ft, GAIN_SCHEDULE_MAX_POINTS);
+        return schedule.altitude_count > 0;
+    }
+    if (!strcmp(name, "schedule_airspeed")) {
+        schedule.airspeed_count = ParseList(value, schedule.airspeeds_kt, GAIN_SCHEDULE_MAX_POINTS);
+        return schedule.airspeed_count > 0;
+    }
+    if (!strcmp(name, "kp_scale")) {
+        if (rows->kp_rows == GAIN_SCHEDULE_MAX_POINTS) {
+            return false;
+        }
+        int length = ParseList(value, rows->kp[rows->kp_rows], GAIN_SCHEDULE_MAX_POINTS);
+        rows->kp_lengths[rows->kp_rows++] = length;
+        return length > 0;
+    }
+    if (!strcmp(name, "ki_scale")) {
+        if (rows->ki_rows == GAIN_SCHEDULE_MAX_POINTS) {
+            return false;
+        }
+        int length = ParseList(value, rows->ki[rows->ki_rows], GAIN_SCHEDULE_MAX_POINTS);
+        rows->ki_lengths[rows->ki_rows++] = length;
+        return length > 0;
+    }
+
+    char* end = nullptr;
+    float number = strtof(value, &end);
+    // kd and the prop feedforwards may be zero; everything else must be
+    // positive
+    bool may_be_zero = !strcmp(name, "kd") || !strcmp(name, "prop_lever_feedforward") || !strcmp(name, "prop_decoupling");
+    bool valid = end && end != value && *end == '\0' && (number > 0.0f || (number == 0.0f && may_be_zero));
+    if (!valid) {
+        return false;
+    }
+    for (int field = 0; field < GAIN_FIELD_COUNT; field++) {
+        if (!strcmp(GAIN_FIELDS[field].name, name)) {
+            profile->gains.*GAIN_FIELDS[field].field = number;
+            return true;
+        }
+    }
+    for (int field = 0; field < SPEED_GAIN_FIELD_COUNT; field++) {
+        if (!strcmp(SPEED_GAIN_FIELDS[field].name, name)) {
+            profile->speed.*SPEED_GAIN_FIELDS[field].field = number;
+            return true;
+        }
+    }
+    for (int field = 0; field < PROP_GAIN_FIELD_COUNT; field++) {
+        if (!strcmp(PROP_GAIN_FIELDS[field].name, name)) {
+            profile->prop.*PROP_GAIN_FIELDS[field].field = number;
+            return true;
+        }
+    }
+    for (int field = 0; field < ACTUATOR_FIELD_COUNT; field++) {
+        if (!strcmp(ACTUATOR_FIELDS[field].name, name)) {
+            profile->actuator.*ACTUATOR_FIELDS[field].field = number;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LoadGainProfile(const char* path, GainProfile* profile) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    GainProfile loaded = DefaultGainProfile();
+    ScheduleRows rows = {};
+    bool ok = true;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), file)) {
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char* text = Trim(line);
+        if (!*text) {
+            continue;
+        }
+
+        char* equals = strchr(text, '=');
+        if (!equals) {
+            ok = false;
+            break;
+        }
+        *equals = '\0';
+        ok = ParseLine(Trim(text), Trim(equals + 1), &loaded, &rows);
+    }
+    fclose(file);
+
+    ok = ok && BuildSchedule(rows, &loaded.schedule) && loaded.speed.rpm_min < loaded.speed.rpm_max;
+    if (ok) {
+        *profile = loaded;
+    }
+    return ok;
+}
+
+void WriteGainProfile(FILE* file, const PidGains& gains, const ActuatorLimits& actuator) {
+    for (int i = 0; i < GAIN_FIELD_COUNT; i++) {
+        fprintf(file, "%s = %g\n", GAIN_FIELDS[i].name, gains.*GAIN_FIELDS[i].field);
+    }
+    for (int i = 0; i < ACTUATOR_FIELD_COUNT; i++) {
+        fprintf(file, "%s = %g\n", ACTUATOR_FIELDS[i].name, actuator.*ACTUATOR_FIELDS[i].field);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef GAIN_PROFILE_H
+#define GAIN_PROFILE_H
+
+#include <stdio.h>
+
+#include "controller.h"
+#include "gain_schedule.h"
+
+// Gain profile: a text file of "name = value" lines (kp, ki, kd, kt,
+// derivative_tau, rate_limit, for the speed modes speed_kp, speed_ki,
+// speed_rpm_min, speed_rpm_max, speed_rate_limit, and for constant-speed
+// props prop_kp, prop_ki, prop_rate_limit, prop_lever_feedforward,
+// prop_decoupling, prop_governor_tau, and for the lever actuator
+// throttle_rate_limit, throttle_accel_limit) with '#' comments, written by
+// the offline tuner and loaded by the plugin from the aircraft's folder.
+//
+// An optional gain schedule follows the same syntax with lists of values:
+//
+//     schedule_density_altitude = 0 6000 12000     # ft, ascending
+//     schedule_airspeed = 60 100 140               # KIAS, ascending
+//     kp_scale = 1.0 0.9 0.8                       # one line per altitude,
+//     kp_scale = 1.3 1.2 1.1                       # one value per airspeed
+//     kp_scale = 1.7 1.5 1.4
+//     ki_scale = ...                               # likewise; all 1 if omitted
+
+const char* const GAIN_PROFILE_FILE_NAME = "xpautothrottle_gains.txt";
+
+struct GainProfile {
+    PidGains gains;
+    GainSchedule schedule;
+    SpeedGains speed;
+    PropGains prop;
+    ActuatorLimits actuator;
+};
+
+// Default gains, no schedule
+GainProfile DefaultGainProfile(void);
+
+// Load a profile over the default gains and an empty schedule. Returns
+// false if the file cannot be read or holds an unknown key, a non-positive
+// gain or scale, an inconsistent schedule or an empty speed RPM range;
+// *profile is only changed on success.
+bool LoadGainProfile(const char* path, GainProfile* profile);
+
+// Write the gain and lever actuator lines of a profile
+void WriteGainProfile(FILE* file, const PidGains& gains, const ActuatorLimits& actuator);
+
+#endif // GAIN_PROFILE_H
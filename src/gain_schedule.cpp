@@ -0,0 +1,64 @@
+#include <cmath>
+
+#include "gain_schedule.h"
+
+// Interval of value among count ascending breakpoints: the lower index and
+// the fraction towards the next, clamped to the ends
+static int Locate(const float* breakpoints, int count, float value, float* fraction) {
+    *fraction = 0.0f;
+    if (count < 2 || value <= breakpoints[0]) {
+        return 0;
+    }
+    int i = 0;
+    while (i < count - 2 && value > breakpoints[i + 1]) {
+        i++;
+    }
+    float span = breakpoints[i + 1] - breakpoints[i];
+    *fraction = (span > 0.0f) ? fminf((value - breakpoints[i]) / span, 1.0f) : 0.0f;
+    return i;
+}
+
+PidGains GainScheduleApply(const GainSchedule& schedule, const PidGains& base, float density_altitude_ft, float airspeed_kt) {
+    if (schedule.altitude_count == 0 || schedule.airspeed_count == 0) {
+        return base;
+    }
+
+    float fa;
+    float fs;
+    int a = Locate(schedule.altitudes_ft, schedule.altitude_count, density_altitude_ft, &fa);
+    int s = Locate(schedule.airspeeds_kt, schedule.airspeed_count, airspeed_kt, &fs);
+    int a1 = (a + 1 < schedule.altitude_count) ? a + 1 : a;
+    int s1 = (s + 1 < schedule.airspeed_count) ? s + 1 : s;
+
+    const int row = schedule.airspeed_count;
+    const GainScheduleCell& c00 = schedule.cells[a * row + s];
+    const GainScheduleCell& c01 = schedule.cells[a * row + s1];
+    const GainScheduleCell& c10 = schedule.cells[a1 * row + s];
+    const GainScheduleCell& c11 = schedule.cells[a1 * row + s1];
+
+    float w00 = (1.0f - fa) * (1.0f - fs);
+    float w01 = (1.0f - fa) * fs;
+    float w10 = fa * (1.0f - fs);
+    float w11 = fa * fs;
+
+    float kp_scale = w00 * c00.kp_scale + w01 * c01.kp_scale + w10 * c10.kp_scale + w11 * c11.kp_scale;
+    float ki_scale = w00 * c00.ki_scale + w01 * c01.ki_scale + w10 * c10.ki_scale + w11 * c11.ki_scale;
+    PidGains gains = base;
+    gains.kp *= kp_scale;
+    gains.ki *= ki_scale;
+    gains.kp_scale *= kp_scale;
+    gains.ki_scale *= ki_scale;
+    return gains;
+}
+
+float DensityAltitudeFt(float density_ratio) {
+    // Troposphere: sigma = (1 - h / 145442 ft) ^ 4.2559
+    if (density_ratio <= 0.0f) {
+        return 0.0f;
+    }
+    return 145442.16f * (1.0f - powf(density_ratio, 0.234969f));
+}
+
+float IndicatedAirspeedKt(float true_airspeed_kt, float density_ratio) {
+    return true_airspeed_kt * sqrtf(fmaxf(density_ratio, 0.0f));
+}
@@ -0,0 +1,40 @@
+#ifndef GAIN_SCHEDULE_H
+#define GAIN_SCHEDULE_H
+
+#include "controller.h"
+
+// Gain schedule: kp and ki multipliers on a grid of density altitude by
+// indicated airspeed, bilinearly interpolated and clamped at the edges.
+// Cells are stored row-major by density altitude with kp and ki
+// interleaved, so one lookup reads two short runs of adjacent floats.
+
+const int GAIN_SCHEDULE_MAX_POINTS = 8;    // Breakpoints per axis
+
+// ISA sea level air density (kg/m^3)
+const float SEA_LEVEL_DENSITY = 1.225f;
+
+struct GainScheduleCell {
+    float kp_scale;
+    float ki_scale;
+};
+
+struct GainSchedule {
+    int altitude_count;     // 0 for no schedule
+    int airspeed_count;
+    float altitudes_ft[GAIN_SCHEDULE_MAX_POINTS];   // Density altitude breakpoints, ascending
+    float airspeeds_kt[GAIN_SCHEDULE_MAX_POINTS];   // Indicated airspeed breakpoints, ascending
+    GainScheduleCell cells[GAIN_SCHEDULE_MAX_POINTS * GAIN_SCHEDULE_MAX_POINTS];
+};
+
+// Scheduled gains at a flight condition: base with kp and ki scaled, and
+// the factors recorded in kp_scale and ki_scale. An empty schedule returns
+// base.
+PidGains GainScheduleApply(const GainSchedule& schedule, const PidGains& base, float density_altitude_ft, float airspeed_kt);
+
+// ISA density altitude (ft) for an air density ratio to sea level
+float DensityAltitudeFt(float density_ratio);
+
+// Indicated airspeed (kt) for a true airspeed and air density ratio
+float IndicatedAirspeedKt(float true_airspeed_kt, float density_ratio);
+
+#endif // GAIN_SCHEDULE_H
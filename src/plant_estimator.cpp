@@ -0,0 +1,169 @@
+#include <cmath>
+#include <string.h>
+
+#include "plant_estimator.h"
+
+// Dead times tried in parallel (seconds)
+const float DEAD_TIMES[PLANT_DEAD_TIME_CANDIDATES] = { 0.0f, 0.1f, 0.2f, 0.35f, 0.5f };
+
+// RPM is fitted in thousands so the parameters are of similar magnitude
+const double RPM_SCALE = 0.001;
+
+const double INITIAL_COVARIANCE = 1000.0;
+const double MAX_COVARIANCE_TRACE = 1e6;    // Covariance is reset beyond this
+const float FORGET_TIME = 30.0f;            // Seconds of data the fit remembers while excited
+const float RESIDUAL_TIME = 5.0f;           // Averaging time of the prediction error (s)
+const double EXCITATION_RATE = 0.02;        // Scaled RPM/s (20 RPM/s) counting as excitation
+const int MIN_EXCITED_UPDATES = 60;         // Before the model is trusted
+
+// Limits of a plausible piston engine and prop
+const float MIN_TIME_CONSTANT = 0.05f;
+const float MAX_TIME_CONSTANT = 20.0f;
+const float MIN_GAIN = 50.0f;
+
+static void ResetFit(PlantFit* fit) {
+    memset(fit, 0, sizeof(*fit));
+    for (int i = 0; i < PLANT_PARAMETERS; i++) {
+        fit->covariance[i][i] = INITIAL_COVARIANCE;
+    }
+}
+
+void PlantEstimatorReset(PlantEstimator* estimator) {
+    memset(estimator, 0, sizeof(*estimator));
+    for (int c = 0; c < PLANT_DEAD_TIME_CANDIDATES; c++) {
+        ResetFit(&estimator->fits[c]);
+    }
+}
+
+// Throttle of an engine in effect at time t. Each history entry holds the
+// throttle applied up to its time, so this is the oldest entry at or after
+// t, or the oldest kept if t is further back.
+static float DelayedThrottle(const PlantEstimator& estimator, int engine, float t) {
+    int index = (estimator.history_next + PLANT_HISTORY - 1) % PLANT_HISTORY;
+    for (int n = 1; n < estimator.history_count; n++) {
+        int previous = (index + PLANT_HISTORY - 1) % PLANT_HISTORY;
+        if (estimator.history_time[previous] < t) {
+            break;
+        }
+        index = previous;
+    }
+    return estimator.history_throttle[index][engine];
+}
+
+// One recursive least squares step with forgetting factor lambda
+static void UpdateFit(PlantFit* fit, const double phi[PLANT_PARAMETERS], double y, double lambda, double residual_alpha) {
+    double p_phi[PLANT_PARAMETERS];
+    double denominator = lambda;
+    for (int i = 0; i < PLANT_PARAMETERS; i++) {
+        p_phi[i] = 0.0;
+        for (int j = 0; j < PLANT_PARAMETERS; j++) {
+            p_phi[i] += fit->covariance[i][j] * phi[j];
+        }
+        denominator += phi[i] * p_phi[i];
+    }
+
+    double error = y;
+    for (int i = 0; i < PLANT_PARAMETERS; i++) {
+        error -= phi[i] * fit->theta[i];
+    }
+    fit->residual += residual_alpha * (error * error - fit->residual);
+
+    double trace = 0.0;
+    for (int i = 0; i < PLANT_PARAMETERS; i++) {
+        double k = p_phi[i] / denominator;
+        fit->theta[i] += k * error;
+        for (int j = 0; j < PLANT_PARAMETERS; j++) {
+            // P is symmetric, so phi' P = (P phi)'
+            fit->covariance[i][j] = (fit->covariance[i][j] - k * p_phi[j]) / lambda;
+        }
+        trace += fit->covariance[i][i];
+    }
+
+    // Covariance windup guard: while the data is uninformative, forgetting
+    // grows P without bound, so start again from the initial covariance
+    if (!(trace < MAX_COVARIANCE_TRACE)) {
+        for (int i = 0; i < PLANT_PARAMETERS; i++) {
+            for (int j = 0; j < PLANT_PARAMETERS; j++) {
+                fit->covariance[i][j] = (i == j) ? INITIAL_COVARIANCE : 0.0;
+            }
+        }
+    }
+}
+
+void PlantEstimatorUpdate(PlantEstimator* estimator, const EngineState& state) {
+    const int num_engines = state.num_engines;
+    if (num_engines != estimator->num_engines) {
+        PlantEstimatorReset(estimator);
+        estimator->num_engines = num_engines;
+    }
+
+    const float dt = state.sample_time - estimator->prev_time;
+    bool have_previous = estimator->history_count > 0 && dt > 0.0f;
+
+    // Record the throttle applied over the interval ending now
+    int slot = estimator->history_next;
+    estimator->history_time[slot] = state.sample_time;
+    for (int i = 0; i < num_engines; i++) {
+        estimator->history_throttle[slot][i] = state.throttle[i];
+    }
+    estimator->history_next = (slot + 1) % PLANT_HISTORY;
+    if (estimator->history_count < PLANT_HISTORY) {
+        estimator->history_count++;
+    }
+
+    if (have_previous) {
+        const float midpoint = state.sample_time - 0.5f * dt;
+        const double residual_alpha = dt / (RESIDUAL_TIME + dt);
+        bool excited = false;
+
+        for (int i = 0; i < num_engines; i++) {
+            // Trapezoidal regression: the rate over the interval against the
+            // mean RPM across it
+            double rate = (state.rpm[i] - estimator->prev_rpm[i]) * RPM_SCALE / dt;
+            double rpm = 0.5 * (state.rpm[i] + estimator->prev_rpm[i]) * RPM_SCALE;
+            bool moving = fabs(rate) > EXCITATION_RATE;
+            excited = excited || moving;
+
+            // Forget once per tick, not once per engine, and only while the
+            // RPM is moving. Steady ticks fit every dead time equally well,
+            // so they do not count towards choosing one either.
+            double lambda = (i == 0 && moving) ? exp(-dt / FORGET_TIME) : 1.0;
+            for (int c = 0; c < PLANT_DEAD_TIME_CANDIDATES; c++) {
+                double phi[PLANT_PARAMETERS] = {
+                    rpm, DelayedThrottle(*estimator, i, midpoint - DEAD_TIMES[c]), 1.0
+                };
+                UpdateFit(&estimator->fits[c], phi, rate, lambda, moving ? residual_alpha : 0.0);
+            }
+        }
+        if (excited) {
+            estimator->excited_updates++;
+        }
+    }
+
+    for (int i = 0; i < num_engines; i++) {
+        estimator->prev_rpm[i] = state.rpm[i];
+    }
+    estimator->prev_time = state.sample_time;
+}
+
+PlantModel PlantEstimatorModel(const PlantEstimator& estimator) {
+    int best = 0;
+    for (int c = 1; c < PLANT_DEAD_TIME_CANDIDATES; c++) {
+        if (estimator.fits[c].residual < estimator.fits[best].residual) {
+            best = c;
+        }
+    }
+
+    // theta = [-1/tau, gain/tau, offset/tau] in scaled RPM
+    const PlantFit& fit = estimator.fits[best];
+    PlantModel model = {};
+    if (fit.theta[0] < 0.0) {
+        model.time_constant = (float)(-1.0 / fit.theta[0]);
+        model.gain = (float)(-fit.theta[1] / fit.theta[0] / RPM_SCALE);
+    }
+    model.dead_time = DEAD_TIMES[best];
+    model.valid = estimator.excited_updates >= MIN_EXCITED_UPDATES &&
+                  model.time_constant >= MIN_TIME_CONSTANT && model.time_constant <= MAX_TIME_CONSTANT &&
+                  model.gain >= MIN_GAIN;
+    return model;
+}
@@ -0,0 +1,59 @@
+#ifndef PLANT_ESTIMATOR_H
+#define PLANT_ESTIMATOR_H
+
+#include "plugin.h"
+
+// Online identification of the throttle -> RPM response as a first order
+// plus dead time model:
+//
+//     d(rpm)/dt = (gain * throttle(t - dead_time) + offset - rpm) / time_constant
+//
+// The continuous form is fitted by recursive least squares on every sampled
+// tick (engaged or not, all engines pooled), so irregular tick intervals need
+// no resampling. One fit runs per candidate dead time and the candidate with
+// the smallest recent prediction error wins. Cost per tick is fixed by the
+// engine count and the candidate count; memory is fixed.
+
+const int PLANT_DEAD_TIME_CANDIDATES = 5;
+const int PLANT_HISTORY = 64;           // Throttle samples kept per engine for the dead time lookup
+const int PLANT_PARAMETERS = 3;         // rpm, delayed throttle, bias
+
+// Fitted plant, valid once the fit has seen enough excitation and is
+// physically plausible (stable, throttle raising RPM)
+struct PlantModel {
+    float gain;             // Steady-state RPM per unit throttle
+    float time_constant;    // Seconds
+    float dead_time;        // Seconds
+    bool valid;
+};
+
+// One recursive least squares fit for a fixed dead time
+struct PlantFit {
+    double theta[PLANT_PARAMETERS];
+    double covariance[PLANT_PARAMETERS][PLANT_PARAMETERS];
+    double residual;        // Low-passed squared prediction error
+};
+
+struct PlantEstimator {
+    PlantFit fits[PLANT_DEAD_TIME_CANDIDATES];
+    float history_time[PLANT_HISTORY];
+    float history_throttle[PLANT_HISTORY][MAX_ENGINES];
+    int history_next;
+    int history_count;
+    float prev_rpm[MAX_ENGINES];
+    float prev_time;
+    int num_engines;        // 0 until the first sample
+    int excited_updates;    // Ticks with the RPM or throttle moving
+};
+
+// Forget everything learned, e.g. for a new aircraft
+void PlantEstimatorReset(PlantEstimator* estimator);
+
+// Feed one sampled tick. The throttle in the sample is taken as the input
+// applied since the previous tick.
+void PlantEstimatorUpdate(PlantEstimator* estimator, const EngineState& state);
+
+// Current best model
+PlantModel PlantEstimatorModel(const PlantEstimator& estimator);
+
+#endif // PLANT_ESTIMATOR_H
@@ -1,16 +1,29 @@
 #include <string.h>
 #include <stdio.h>
+#include <cmath>
 #include <cstring>
 #include <ctime>
 
 #include "XPLMPlugin.h"
 #include "XPLMMenus.h"
+#include "XPLMPlanes.h"
 #include "XPLMDataAccess.h"
 #include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
 #include "XPWidgets.h"
 #include "XPStandardWidgets.h"
 #include "XPWidgetDefs.h"
 
+#include "black_box.h"
+#include "controller.h"
+#include "dataref.h"
+#include "gain_profile.h"
+#include "gain_schedule.h"
+#include "plugin.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "widget_binding.h"
+
 // Window dimensions
 const int WINDOW_WIDTH = 130;
 const int WINDOW_HEIGHT = 310;
@@ -27,42 +40,295 @@ const int SLIDER_WIDTH = 20;
 const int PRESET_BUTTON_X = SLIDER_X + SLIDER_WIDTH + 15; // To the right of slider with more spacing
 const int PRESET_BUTTON_WIDTH = 35;
 const int PRESET_BUTTON_HEIGHT = 20;
-const int PRESET_2400_Y = SLIDER_Y_TOP; // Top preset button
-const int PRESET_1000_Y = PRESET_2400_Y - PRESET_BUTTON_HEIGHT - 5; // Stacked under 2400 button with more space
+const int PRESET_HIGH_Y = SLIDER_Y_TOP; // Top preset button
+const int PRESET_LOW_Y = PRESET_HIGH_Y - PRESET_BUTTON_HEIGHT - 5; // Stacked under the high preset with more space
+const int MODE_BUTTON_Y = PRESET_LOW_Y - PRESET_BUTTON_HEIGHT - 15; // Set apart from the presets
+const int VARIABLE_BUTTON_Y = MODE_BUTTON_Y - PRESET_BUTTON_HEIGHT - 5;
 const int SLIDER_VALUE_LABEL_Y = WINDOW_TOP - 230;
 const int CHECKBOX_Y = WINDOW_TOP - 250;
 const int BUTTON_Y = WINDOW_TOP - 275;
 
-const char* DATAREF_ENGINE_RPM = "sim/cockpit2/engine/indicators/engine_speed_rpm";
-const char* DATAREF_THROTTLE_POSITION = "sim/cockpit2/engine/actuators/throttle_ratio_all";
+// Engine variables the engine mode can hold. Samples are scaled into the
+// control core's units, which span about the same range as piston RPM, so
+// its gains, tolerance and plant estimator serve every variable. Holding
+// manifold pressure is the constant-speed prop mode: the prop lever holds
+// the prop RPM target alongside.
+enum EngineVariable {
+    ENGINE_VARIABLE_RPM = 0,
+    ENGINE_VARIABLE_N1,
+    ENGINE_VARIABLE_TORQUE,
+    ENGINE_VARIABLE_EPR,
+    ENGINE_VARIABLE_FUEL_FLOW,
+    ENGINE_VARIABLE_MANIFOLD,
+    ENGINE_VARIABLE_COUNT
+};
+
+struct VariableDefinition {
+    const char* name;           // Variable button caption
+    const char* dataref;        // Per-engine indicator
+    float dataref_scale;        // Displayed units per dataref unit
+    float control_scale;        // Control units per displayed unit
+    const char* label;          // Value caption prefix
+    const char* units;          // Units of xpautothrottle/target and error
+    int presets[2];             // High and low preset targets (slider units)
+    int prop_presets[2];        // Prop RPM set with each preset; zero for no prop loop
+};
+
+const VariableDefinition VARIABLE_DEFINITIONS[ENGINE_VARIABLE_COUNT] = {
+    { "RPM", "sim/cockpit2/engine/indicators/engine_speed_rpm", 1.0f, 1.0f, "RPM: ", "rpm", { 2400, 1000 }, { 0, 0 } },
+    { "N1", "sim/cockpit2/engine/indicators/N1_percent", 1.0f, 20.0f, "N1: ", "percent", { 950, 700 }, { 0, 0 } },
+    { "TRQ", "sim/cockpit2/engine/indicators/torque_n_mtr", 1.0f, 0.75f, "TRQ: ", "Nm", { 2400, 1200 }, { 0, 0 } },
+    { "EPR", "sim/cockpit2/engine/indicators/EPR_ratio", 1.0f, 2500.0f, "EPR: ", "ratio", { 160, 110 }, { 0, 0 } },
+    { "FF", "sim/cockpit2/engine/indicators/fuel_flow_kg_sec", 3600.0f, 0.75f, "FF: ", "kg/h", { 2000, 800 }, { 0, 0 } },
+    { "MP", "sim/cockpit2/engine/indicators/MPR_in_hg", 1.0f, 80.0f, "MP: ", "inHg", { 250, 220 }, { 2500, 2300 } },
+};
+
+// Target range and step in slider units, shared by the slider and the
+// commands. Slider units are the displayed units with the decimals
+// dropped, e.g. tenths of N1 percent.
+struct TargetDefinition {
+    const char* label;          // Target caption prefix
+    const char* units;          // Caption suffix
+    int decimals;
+    int scale;                  // Slider units per displayed unit (10^decimals)
+    int min;
+    int max;
+    int step;
+};
+
+// Targets: one per engine variable, the speed mode targets, then the
+// constant-speed prop RPM
+const int TARGET_IAS = ENGINE_VARIABLE_COUNT;
+const int TARGET_MACH = ENGINE_VARIABLE_COUNT + 1;
+const int TARGET_PROP_RPM = ENGINE_VARIABLE_COUNT + 2;
+const int TARGET_COUNT = ENGINE_VARIABLE_COUNT + 3;
+
+const TargetDefinition TARGET_DEFINITIONS[TARGET_COUNT] = {
+    { "Target RPM: ", "", 0, 1, 0, 2500, 100 },
+    { "Target N1: ", "%", 1, 10, 200, 1050, 5 },
+    { "Target TRQ: ", " Nm", 0, 1, 0, 4000, 50 },
+    { "Target EPR: ", "", 2, 100, 90, 200, 1 },
+    { "Target FF: ", " kg/h", 0, 1, 0, 5000, 50 },
+    { "Target MP: ", " in", 1, 10, 100, 400, 5 },
+    { "Target IAS: ", "", 0, 1, 40, 350, 5 },
+    { "Target M: ", "", 2, 100, 10, 95, 1 },
+    { "Target prop: ", "", 0, 1, 1500, 2800, 50 },
+};
+
+// Mode button captions
+const char* const MODE_NAMES[AUTOTHROTTLE_MODE_COUNT] = { "ENG", "IAS", "MACH" };
+
+const char* DATAREF_ENGINE_TYPE = "sim/aircraft/prop/acf_en_type";
+const char* DATAREF_PROP_TYPE = "sim/aircraft/prop/acf_prop_type";
+const char* DATAREF_PROP_RPM = "sim/cockpit2/engine/indicators/prop_speed_rpm";
+const char* DATAREF_PROP_LEVER = "sim/cockpit2/engine/actuators/prop_ratio";
+const char* DATAREF_THROTTLE_POSITION = "sim/cockpit2/engine/actuators/throttle_ratio";
+const char* DATAREF_THROTTLE_USED = "sim/flightmodel/engine/ENGN_thro_use";
+const char* DATAREF_OVERRIDE_THROTTLES = "sim/operation/override/override_throttles";
+const char* DATAREF_NUM_ENGINES = "sim/aircraft/engine/acf_num_engines";
+const char* DATAREF_AIR_DENSITY = "sim/weather/rho";
+const char* DATAREF_INDICATED_AIRSPEED = "sim/flightmodel/position/indicated_airspeed";
+const char* DATAREF_MACH = "sim/flightmodel/misc/machno";
+const char* DATAREF_SIM_TIME = "sim/time/total_running_time_sec";
+const char* DATAREF_PAUSED = "sim/time/paused";
+const char* DATAREF_REPLAY = "sim/operation/prefs/replay_mode";
 
 static XPWidgetID g_main_window = nullptr;
 static XPWidgetID g_rpm_label = nullptr;
 static XPWidgetID g_throttle_label = nullptr;
 static XPWidgetID g_rpm_slider = nullptr;
 static XPWidgetID g_slider_value_label = nullptr;
-static XPWidgetID g_rpm_preset_2400 = nullptr;
-static XPWidgetID g_rpm_preset_1000 = nullptr;
+static XPWidgetID g_preset_high = nullptr;
+static XPWidgetID g_preset_low = nullptr;
+static XPWidgetID g_mode_button = nullptr;
+static XPWidgetID g_variable_button = nullptr;
 static XPWidgetID g_autothrottle_button = nullptr;
 static XPWidgetID g_reload_button = nullptr;
 
+// Label bindings: each caption is only rewritten when its displayed value changes
+static LabelBinding g_rpm_binding = {};
+static LabelBinding g_throttle_binding = {};
+static LabelBinding g_target_binding = {};
+
 static bool g_autothrottle_enabled = false;
 
-static XPLMDataRef g_rpm_dataref = nullptr;
-static XPLMDataRef g_throttle_dataref = nullptr;
+// Throttle ownership: when a throttle axis fights the autothrottle, the
+// plugin overrides X-Plane's throttles while engaged and flies the engines
+// through ENGN_thro_use, which the axis does not write. With ownership
+// turned off, moving the throttles disengages instead.
+static bool g_own_throttles = true;
+static bool g_owning_throttles = false;
+static int g_mode = AUTOTHROTTLE_MODE_ENGINE;
+static int g_variable = ENGINE_VARIABLE_RPM;
+static int g_targets[TARGET_COUNT] = { 1000, 700, 1200, 120, 800, 230, 100, 78, 2300 }; // Slider units
+
+static EngineState g_engine_state = {};
+
+static DataRef<float> g_engine_datarefs[ENGINE_VARIABLE_COUNT] = {
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_RPM].dataref),
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_N1].dataref),
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_TORQUE].dataref),
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_EPR].dataref),
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_FUEL_FLOW].dataref),
+    DataRef<float>(VARIABLE_DEFINITIONS[ENGINE_VARIABLE_MANIFOLD].dataref),
+};
+static DataRef<int> g_engine_type_dataref(DATAREF_ENGINE_TYPE);
+static DataRef<int> g_prop_type_dataref(DATAREF_PROP_TYPE);
+static DataRef<float> g_prop_rpm_dataref(DATAREF_PROP_RPM);
+static DataRef<float> g_prop_lever_dataref(DATAREF_PROP_LEVER);
+static DataRef<float> g_throttle_dataref(DATAREF_THROTTLE_POSITION);
+static DataRef<float> g_throttle_used_dataref(DATAREF_THROTTLE_USED);
+static DataRef<int> g_override_throttles_dataref(DATAREF_OVERRIDE_THROTTLES);
+static DataRef<int> g_num_engines_dataref(DATAREF_NUM_ENGINES);
+static DataRef<float> g_air_density_dataref(DATAREF_AIR_DENSITY);
+static DataRef<float> g_indicated_airspeed_dataref(DATAREF_INDICATED_AIRSPEED);
+static DataRef<float> g_mach_dataref(DATAREF_MACH);
+static DataRef<float> g_sim_time_dataref(DATAREF_SIM_TIME);
+static DataRef<int> g_paused_dataref(DATAREF_PAUSED);
+static DataRef<int> g_replay_dataref(DATAREF_REPLAY);
+
+// Engine count of the loaded aircraft, refreshed with the dataref handles
+static int g_num_engines = 1;
+
+// The control loop runs before the flight model, so a throttle write is
+// flown in the same frame; the labels refresh from a separate low-rate
+// loop
+static XPLMFlightLoopID g_flight_loop = nullptr;
+static XPLMFlightLoopID g_ui_flight_loop = nullptr;
+
+// Commands for binding hardware buttons; the refcon passed to the handler
+// is the CommandAction
+enum CommandAction {
+    COMMAND_TOGGLE = 0,
+    COMMAND_ENGAGE,
+    COMMAND_DISENGAGE,
+    COMMAND_TARGET_UP,
+    COMMAND_TARGET_DOWN,
+    COMMAND_PRESET_HIGH,
+    COMMAND_PRESET_LOW,
+    COMMAND_MODE_ENGINE,
+    COMMAND_MODE_IAS,
+    COMMAND_MODE_MACH,
+    COMMAND_VARIABLE_RPM,       // Through COMMAND_VARIABLE_RPM + ENGINE_VARIABLE_COUNT - 1
+    COMMAND_VARIABLE_N1,
+    COMMAND_VARIABLE_TORQUE,
+    COMMAND_VARIABLE_EPR,
+    COMMAND_VARIABLE_FUEL_FLOW,
+    COMMAND_VARIABLE_MANIFOLD,
+    COMMAND_PROP_UP,
+    COMMAND_PROP_DOWN,
+    COMMAND_PRESET_2400,        // Names of the presets from before turbine support
+    COMMAND_PRESET_1000,
+    COMMAND_MODE_RPM,           // Name of mode_engine from before turbine support
+    COMMAND_COUNT
+};
+
+struct CommandDefinition {
+    const char* name;
+    const char* description;
+};
+
+const CommandDefinition COMMAND_DEFINITIONS[COMMAND_COUNT] = {
+    { "xpautothrottle/toggle", "Toggle the autothrottle" },
+    { "xpautothrottle/engage", "Engage the autothrottle" },
+    { "xpautothrottle/disengage", "Disengage the autothrottle" },
+    { "xpautothrottle/target_up", "Increase the target by one step" },
+    { "xpautothrottle/target_down", "Decrease the target by one step" },
+    { "xpautothrottle/preset_high", "Hold the engine variable's high preset" },
+    { "xpautothrottle/preset_low", "Hold the engine variable's low preset" },
+    { "xpautothrottle/mode_engine", "Hold the engine variable's target" },
+    { "xpautothrottle/mode_ias", "Hold the target indicated airspeed" },
+    { "xpautothrottle/mode_mach", "Hold the target Mach number" },
+    { "xpautothrottle/variable_rpm", "Control engine RPM" },
+    { "xpautothrottle/variable_n1", "Control N1" },
+    { "xpautothrottle/variable_torque", "Control engine torque" },
+    { "xpautothrottle/variable_epr", "Control EPR" },
+    { "xpautothrottle/variable_fuel_flow", "Control fuel flow" },
+    { "xpautothrottle/variable_manifold", "Control manifold pressure and prop RPM" },
+    { "xpautothrottle/prop_up", "Increase the prop RPM target by one step" },
+    { "xpautothrottle/prop_down", "Decrease the prop RPM target by one step" },
+    { "xpautothrottle/preset_2400", "Same as preset_high" },
+    { "xpautothrottle/preset_1000", "Same as preset_low" },
+    { "xpautothrottle/mode_rpm", "Same as mode_engine" },
+};
+
+static XPLMCommandRef g_commands[COMMAND_COUNT] = {};
 
-// Autothrottle timing variables
-static float g_total_elapsed_time = 0.0f;
-static float g_last_throttle_adjust_time = 0.0f;
-static float g_rpm_out_of_tolerance_start_time = -1.0f;
+// Controller state published under xpautothrottle/ for other plugins and
+// cockpit hardware. The accessors only read these cached copies, refreshed
+// each tick, so a dataref read never touches widgets or sim datarefs.
+static float g_published_error[MAX_ENGINES] = {};              // Engine target minus the variable per engine
+static float g_published_commanded_throttle[MAX_ENGINES] = {}; // Last throttle written per engine
+static float g_published_speed_error = 0.0f;                   // Target minus airspeed (kt) in the speed modes
+static int g_published_num_engines = 0;
+static PlantModel g_published_plant = {};                      // Fitted throttle -> RPM response
+static PidGains g_published_gains = {};                        // Gains of the last controller step
+
+static XPLMDataRef g_engaged_dataref = nullptr;
+static XPLMDataRef g_target_rpm_dataref = nullptr;
+static XPLMDataRef g_target_dataref = nullptr;
+static XPLMDataRef g_variable_dataref = nullptr;
+static XPLMDataRef g_error_dataref = nullptr;
+static XPLMDataRef g_error_units_dataref = nullptr;
+static XPLMDataRef g_rpm_error_dataref = nullptr;
+static XPLMDataRef g_commanded_throttle_dataref = nullptr;
+static XPLMDataRef g_adaptive_dataref = nullptr;
+static XPLMDataRef g_own_throttles_dataref = nullptr;
+static XPLMDataRef g_mode_dataref = nullptr;
+static XPLMDataRef g_target_ias_dataref = nullptr;
+static XPLMDataRef g_target_mach_dataref = nullptr;
+static XPLMDataRef g_target_prop_rpm_dataref = nullptr;
+static XPLMDataRef g_speed_error_dataref = nullptr;
+static XPLMDataRef g_plant_datarefs[5] = {};
+
+// Flight loop intervals: negative values are in frames, 0 suspends the loop
+const float LOOP_INTERVAL_EVERY_FRAME = -1.0f;
+const float LOOP_INTERVAL_IDLE = 0.1f;
+const float LOOP_INTERVAL_SUSPENDED = 0.0f;
+const float LOOP_INTERVAL_UI = 0.1f;           // Label refresh while the window is visible
+
+// Sim time of the last tick (s). It stands still while paused and runs
+// ahead of the frame clock under time compression, so the control law's
+// dt follows the physics rather than the wall clock. Kept in double so dt
+// does not lose precision as the sim clock grows over a long session.
+static double g_sim_time = 0.0;
+
+// Set while the loop is suspended, paused or replaying, so the first tick
+// after it carries on does not see the whole gap as one step
+static bool g_loop_resuming = true;
+const float MAX_RESUME_DT = 0.5f;
+
+// Autothrottle controller state
+static GainProfile g_gain_profile = DefaultGainProfile();
+static Autothrottle g_autothrottle = {};
 
 static int WidgetCallback(XPWidgetMessage inMessage, XPWidgetID inWidget, intptr_t inParam1, intptr_t inParam2);
 static float FlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void* inRefcon);
+static float UiLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void* inRefcon);
 static void UpdateDatarefHandles(void);
-static void UpdateRpmLabel(void);
-static void UpdateThrottleLabel(void);
-static void UpdateSliderValueLabel(void);
-static void UpdateAutothrottle(void);
+static void SampleEngineState(EngineState* state, float elapsed);
+static void UpdateRpmLabel(const EngineState& state);
+static void UpdateThrottleLabel(const EngineState& state);
+static void UpdateSliderValueLabel(int target);
+static bool UpdateAutothrottle(const EngineState& state);
+static void WakeFlightLoop(void);
+static void WakeUiLoop(void);
+static void SetAutothrottleEnabled(bool enabled);
+static void ReleaseThrottles(void);
+static int TargetSlot(int mode);
+static void SetTarget(int slot, int target);
+static void SetMode(int mode);
+static void SetVariable(int variable);
+static void SelectPreset(int preset);
+static void SelectAircraftVariable(void);
+static int CommandHandler(XPLMCommandRef inCommand, XPLMCommandPhase inPhase, void* inRefcon);
+static void RegisterStateDatarefs(void);
+static void UnregisterStateDatarefs(void);
+static void OutputPath(char* path, size_t size, const char* file_name);
+static void StartRecorder(void);
+static void OpenBlackBox(void);
+static void LoadAircraftGains(void);
+static void RecordSample(const EngineState& state);
 static void CreatePopupWindow(void);
 static void XPAutothrottleMenuHandler(void * mRef, void * iRef);
 
@@ -80,12 +346,24 @@ PLUGIN_API int XPluginStart(char* outName, char* outSignature, char* outDescript
         XPLMEnableFeature("XPLM_USE_NATIVE_WIDGET_WINDOWS", 1);
     }
 
+    // Ask for XPLM_MSG_DATAREFS_ADDED, so datarefs an aircraft or another
+    // plugin publishes after load are picked up
+    if (XPLMHasFeature("XPLM_WANTS_DATAREF_NOTIFICATIONS")) {
+        XPLMEnableFeature("XPLM_WANTS_DATAREF_NOTIFICATIONS", 1);
+    }
+
     item = XPLMAppendMenuItem(XPLMFindPluginsMenu(), "XPAutoThrottle", NULL, 1);
     id = XPLMCreateMenu("XPAutoThrottle", XPLMFindPluginsMenu(), item, XPAutothrottleMenuHandler, NULL);
     XPLMAppendMenuItem(id, "Show Window", (void *)"Show", 1);
     XPLMAppendMenuItem(id, "Hide Window", (void *)"Hide", 1);
     XPLMAppendMenuItem(id, "Reload plugins", (void *)"Reload", 1);
 
+    g_autothrottle.adaptive = true;
+    
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        g_commands[i] = XPLMCreateCommand(COMMAND_DEFINITIONS[i].name, COMMAND_DEFINITIONS[i].description);
+    }
+
     return 1;
 }
 
@@ -97,19 +375,37 @@ PLUGIN_API void XPluginStop(void) {
         g_throttle_label = nullptr;
         g_rpm_slider = nullptr;
         g_slider_value_label = nullptr;
-        g_rpm_preset_2400 = nullptr;
-        g_rpm_preset_1000 = nullptr;
+        g_preset_high = nullptr;
+        g_preset_low = nullptr;
+        g_mode_button = nullptr;
+        g_variable_button = nullptr;
         g_autothrottle_button = nullptr;
         g_reload_button = nullptr;
-        g_rpm_dataref = nullptr;
-        g_throttle_dataref = nullptr;
+        UnbindLabel(&g_rpm_binding);
+        UnbindLabel(&g_throttle_binding);
+        UnbindLabel(&g_target_binding);
+        for (DataRef<float>& dataref : g_engine_datarefs) {
+            dataref.Invalidate();
+        }
+        g_throttle_dataref.Invalidate();
+        g_throttle_used_dataref.Invalidate();
+        g_override_throttles_dataref.Invalidate();
+        g_prop_lever_dataref.Invalidate();
         g_autothrottle_enabled = false;
     }
 }
 
 PLUGIN_API int XPluginEnable(void) {
-    g_rpm_dataref = XPLMFindDataRef(DATAREF_ENGINE_RPM);
-    g_throttle_dataref = XPLMFindDataRef(DATAREF_THROTTLE_POSITION);
+    UpdateDatarefHandles();
+    g_sim_time = g_sim_time_dataref.Get();
+    g_loop_resuming = true;
+    SelectAircraftVariable();
+    LoadAircraftGains();
+    ProfilerRegisterDatarefs();
+    RegisterStateDatarefs();
+    RecorderRegisterDatarefs();
+    StartRecorder();
+    OpenBlackBox();
     
     if (!g_main_window) {
         CreatePopupWindow();
@@ -117,13 +413,47 @@ PLUGIN_API int XPluginEnable(void) {
         XPShowWidget(g_main_window);
     }
     
-    XPLMRegisterFlightLoopCallback(FlightLoopCallback, 0.1f, nullptr);
+    XPLMCreateFlightLoop_t loop_params;
+    loop_params.structSize = sizeof(loop_params);
+    loop_params.phase = xplm_FlightLoop_Phase_BeforeFlightModel;
+    loop_params.callbackFunc = FlightLoopCallback;
+    loop_params.refcon = nullptr;
+    g_flight_loop = XPLMCreateFlightLoop(&loop_params);
+    WakeFlightLoop();
+    
+    loop_params.phase = xplm_FlightLoop_Phase_AfterFlightModel;
+    loop_params.callbackFunc = UiLoopCallback;
+    g_ui_flight_loop = XPLMCreateFlightLoop(&loop_params);
+    WakeUiLoop();
+    
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        XPLMRegisterCommandHandler(g_commands[i], CommandHandler, 1, (void*)(intptr_t)i);
+    }
     
     return 1;
 }
 
 PLUGIN_API void XPluginDisable(void) {
-    XPLMUnregisterFlightLoopCallback(FlightLoopCallback, nullptr);
+    ReleaseThrottles();
+    
+    for (int i = 0; i < COMMAND_COUNT; i++) {
+        XPLMUnregisterCommandHandler(g_commands[i], CommandHandler, 1, (void*)(intptr_t)i);
+    }
+    
+    BlackBoxClose();
+    RecorderStop();
+    RecorderUnregisterDatarefs();
+    UnregisterStateDatarefs();
+    ProfilerUnregisterDatarefs();
+    
+    if (g_flight_loop) {
+        XPLMDestroyFlightLoop(g_flight_loop);
+        g_flight_loop = nullptr;
+    }
+    if (g_ui_flight_loop) {
+        XPLMDestroyFlightLoop(g_ui_flight_loop);
+        g_ui_flight_loop = nullptr;
+    }
     
     if (g_main_window) {
         XPShowWidget(g_main_window);
@@ -132,8 +462,58 @@ PLUGIN_API void XPluginDisable(void) {
 
 PLUGIN_API void XPluginReceiveMessage(XPLMPluginID inFrom, int inMessage, void* inParam) {
     (void)inFrom;
-    (void)inMessage;
-    (void)inParam;
+
+    // Aircraft and other plugins can publish or replace datarefs, so
+    // re-resolve handles and types whenever the set may have changed
+    if (inMessage == XPLM_MSG_PLANE_LOADED || inMessage == XPLM_MSG_DATAREFS_ADDED) {
+        UpdateDatarefHandles();
+    }
+
+    // Index 0 is the user aircraft; AI and multiplayer loads leave the
+    // controller alone. The new aircraft may have a different engine count
+    // and has a new engine and prop, so re-engage and relearn it, and leave
+    // its levers to X-Plane until the autothrottle takes them
+    if (inMessage == XPLM_MSG_PLANE_LOADED && (intptr_t)inParam == 0) {
+        g_autothrottle.engaged = false;
+        ReleaseThrottles();
+        SelectAircraftVariable();
+        LoadAircraftGains();
+        PlantEstimatorReset(&g_autothrottle.estimator);
+    }
+
+    if (inMessage == XPLM_MSG_PLANE_CRASHED) {
+        BlackBoxRecordEvent(BLACK_BOX_PLANE_CRASHED, g_sim_time, (float)g_engine_state.target_rpm, 0.0f);
+        BlackBoxFlush();
+    }
+}
+
+// Resolve dataref handles and pick their typed accessors
+static void UpdateDatarefHandles(void) {
+    for (DataRef<float>& dataref : g_engine_datarefs) {
+        dataref.Bind();
+    }
+    g_engine_type_dataref.Bind();
+    g_prop_type_dataref.Bind();
+    g_prop_rpm_dataref.Bind();
+    g_prop_lever_dataref.Bind();
+    g_throttle_dataref.Bind();
+    g_throttle_used_dataref.Bind();
+    g_override_throttles_dataref.Bind();
+    g_air_density_dataref.Bind();
+    g_indicated_airspeed_dataref.Bind();
+    g_mach_dataref.Bind();
+    g_sim_time_dataref.Bind();
+    g_paused_dataref.Bind();
+    g_replay_dataref.Bind();
+
+    // The engine count only changes with the aircraft, so cache it here
+    // rather than reading it every tick
+    g_num_engines = 1;
+    if (g_num_engines_dataref.Bind()) {
+        g_num_engines = g_num_engines_dataref.Get();
+    }
+    if (g_num_engines < 0) g_num_engines = 0;
+    if (g_num_engines > MAX_ENGINES) g_num_engines = MAX_ENGINES;
 }
 
 void XPAutothrottleMenuHandler(void * mRef, void * iRef) {
@@ -145,6 +525,8 @@ void XPAutothrottleMenuHandler(void * mRef, void * iRef) {
         } else {
             XPShowWidget(g_main_window);
         }
+        WakeFlightLoop();
+        WakeUiLoop();
     } else if (!strcmp((char *) iRef, "Hide")) {
         if (g_main_window) {
             XPHideWidget(g_main_window);
@@ -168,10 +550,10 @@ static void CreatePopupWindow(void) {
         XPSetWidgetProperty(g_main_window, xpProperty_MainWindowHasCloseBoxes, 1);
         XPAddWidgetCallback(g_main_window, WidgetCallback);
         
-        // Create RPM label
+        // Create engine variable label, bound for the variable below
         g_rpm_label = XPCreateWidget(
             WINDOW_LEFT + 10, RPM_LABEL_Y, WINDOW_LEFT + WINDOW_WIDTH - 10, RPM_LABEL_Y - 20,
-            1, "RPM: 0",
+            1, "",
             0, g_main_window,
             xpWidgetClass_Caption
         );
@@ -183,8 +565,9 @@ static void CreatePopupWindow(void) {
             0, g_main_window,
             xpWidgetClass_Caption
         );
+        BindLabel(&g_throttle_binding, g_throttle_label, "Throttle: ", 1, "%");
         
-        // Create RPM slider (0 to 2500) - vertical slider
+        // Create target slider - vertical slider, ranged for the hold mode
         // Vertical slider: narrow width (20px), tall height (150px)
         g_rpm_slider = XPCreateWidget(
             SLIDER_X, SLIDER_Y_TOP, SLIDER_X + 20, SLIDER_Y_BOTTOM,
@@ -193,44 +576,64 @@ static void CreatePopupWindow(void) {
             xpWidgetClass_ScrollBar
         );
         
-        // Set slider properties
         XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarType, xpScrollBarTypeSlider);
-        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarMin, 0);
-        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarMax, 2500);
-        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, 1000); // Default to 1000 RPM
-        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarPageAmount, 100);
         
-        // Create slider value label to show current target RPM
+        // Create slider value label to show the current target
         g_slider_value_label = XPCreateWidget(
             WINDOW_LEFT + 10, SLIDER_VALUE_LABEL_Y, WINDOW_LEFT + WINDOW_WIDTH - 10, SLIDER_VALUE_LABEL_Y - 15,
-            1, "Target RPM: 1000",
+            1, "",
             0, g_main_window,
             xpWidgetClass_Caption
         );
         
-        // Create preset RPM buttons to the right of slider
-        g_rpm_preset_2400 = XPCreateWidget(
-            PRESET_BUTTON_X, PRESET_2400_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, PRESET_2400_Y - PRESET_BUTTON_HEIGHT,
-            1, "2400",
+        // Create preset buttons to the right of slider, captioned for the
+        // variable below
+        g_preset_high = XPCreateWidget(
+            PRESET_BUTTON_X, PRESET_HIGH_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, PRESET_HIGH_Y - PRESET_BUTTON_HEIGHT,
+            1, "",
+            0, g_main_window,
+            xpWidgetClass_Button
+        );
+        XPSetWidgetProperty(g_preset_high, xpProperty_ButtonType, xpPushButton);
+        XPSetWidgetProperty(g_preset_high, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
+        
+        g_preset_low = XPCreateWidget(
+            PRESET_BUTTON_X, PRESET_LOW_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, PRESET_LOW_Y - PRESET_BUTTON_HEIGHT,
+            1, "",
+            0, g_main_window,
+            xpWidgetClass_Button
+        );
+        XPSetWidgetProperty(g_preset_low, xpProperty_ButtonType, xpPushButton);
+        XPSetWidgetProperty(g_preset_low, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
+        
+        // Hold mode button under the presets: cycles engine, IAS and Mach
+        g_mode_button = XPCreateWidget(
+            PRESET_BUTTON_X, MODE_BUTTON_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, MODE_BUTTON_Y - PRESET_BUTTON_HEIGHT,
+            1, MODE_NAMES[g_mode],
             0, g_main_window,
             xpWidgetClass_Button
         );
-        XPSetWidgetProperty(g_rpm_preset_2400, xpProperty_ButtonType, xpPushButton);
-        XPSetWidgetProperty(g_rpm_preset_2400, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
+        XPSetWidgetProperty(g_mode_button, xpProperty_ButtonType, xpPushButton);
+        XPSetWidgetProperty(g_mode_button, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
         
-        g_rpm_preset_1000 = XPCreateWidget(
-            PRESET_BUTTON_X, PRESET_1000_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, PRESET_1000_Y - PRESET_BUTTON_HEIGHT,
-            1, "1000",
+        // Engine variable button: cycles RPM, N1, torque, EPR and fuel flow
+        g_variable_button = XPCreateWidget(
+            PRESET_BUTTON_X, VARIABLE_BUTTON_Y, PRESET_BUTTON_X + PRESET_BUTTON_WIDTH, VARIABLE_BUTTON_Y - PRESET_BUTTON_HEIGHT,
+            1, VARIABLE_DEFINITIONS[g_variable].name,
             0, g_main_window,
             xpWidgetClass_Button
         );
-        XPSetWidgetProperty(g_rpm_preset_1000, xpProperty_ButtonType, xpPushButton);
-        XPSetWidgetProperty(g_rpm_preset_1000, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
+        XPSetWidgetProperty(g_variable_button, xpProperty_ButtonType, xpPushButton);
+        XPSetWidgetProperty(g_variable_button, xpProperty_ButtonBehavior, xpButtonBehaviorPushButton);
+        
+        // Caption the labels and presets and range the slider for the
+        // variable and hold mode
+        SetVariable(g_variable);
         
         // Create autothrottle toggle button (ON/OFF) - same width as Reload button
         g_autothrottle_button = XPCreateWidget(
             WINDOW_LEFT + 10, CHECKBOX_Y, WINDOW_LEFT + 120, CHECKBOX_Y - 20,
-            1, "OFF",
+            1, g_autothrottle_enabled ? "ON" : "OFF",
             0, g_main_window,
             xpWidgetClass_Button
         );
@@ -262,20 +665,22 @@ int WidgetCallback(XPWidgetMessage inMessage, XPWidgetID inWidget, intptr_t inPa
         }
     }
     
-    // Handle preset RPM button presses
+    // Handle preset, mode and variable button presses
     if (inMessage == xpMsg_PushButtonPressed) {
-        if ((XPWidgetID)inParam1 == g_rpm_preset_2400) {
-            // Set slider to 2400 RPM (already a 100 increment)
-            XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, 2400);
-            // Update label immediately
-            UpdateSliderValueLabel();
+        if ((XPWidgetID)inParam1 == g_preset_high) {
+            SelectPreset(0);
+            return 1;
+        }
+        if ((XPWidgetID)inParam1 == g_preset_low) {
+            SelectPreset(1);
+            return 1;
+        }
+        if ((XPWidgetID)inParam1 == g_mode_button) {
+            SetMode((g_mode + 1) % AUTOTHROTTLE_MODE_COUNT);
             return 1;
         }
-        if ((XPWidgetID)inParam1 == g_rpm_preset_1000) {
-            // Set slider to 1000 RPM (already a 100 increment)
-            XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, 1000);
-            // Update label immediately
-            UpdateSliderValueLabel();
+        if ((XPWidgetID)inParam1 == g_variable_button) {
+            SetVariable((g_variable + 1) % ENGINE_VARIABLE_COUNT);
             return 1;
         }
         if ((XPWidgetID)inParam1 == g_reload_button) {
@@ -287,23 +692,13 @@ int WidgetCallback(XPWidgetMessage inMessage, XPWidgetID inWidget, intptr_t inPa
     // Handle slider position change
     if (inMessage == xpMsg_ScrollBarSliderPositionChanged) {
         if ((XPWidgetID)inParam1 == g_rpm_slider) {
-            // Get current slider value and snap to nearest 100
+            // Get current slider value and snap to the mode's step
+            const int slot = TargetSlot(g_mode);
+            const int step = TARGET_DEFINITIONS[slot].step;
             int slider_value = (int)XPGetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, NULL);
-            int snapped_value = ((slider_value + 50) / 100) * 100; // Round to nearest 100
+            int snapped_value = ((slider_value + step / 2) / step) * step;
             
-            // Clamp to valid range (0-2500)
-            if (snapped_value < 0) snapped_value = 0;
-            if (snapped_value > 2500) snapped_value = 2500;
-            
-            // Update slider position to snapped value
-            XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, snapped_value);
-            
-            // Update slider value label
-            char label_text[256];
-            snprintf(label_text, sizeof(label_text), "Target RPM: %d", snapped_value);
-            if (g_slider_value_label) {
-                XPSetWidgetDescriptor(g_slider_value_label, label_text);
-            }
+            SetTarget(slot, snapped_value);
             return 1;
         }
     }
@@ -311,16 +706,7 @@ int WidgetCallback(XPWidgetMessage inMessage, XPWidgetID inWidget, intptr_t inPa
     // Handle autothrottle button press
     if (inMessage == xpMsg_PushButtonPressed) {
         if ((XPWidgetID)inParam1 == g_autothrottle_button) {
-            // Toggle autothrottle state
-            g_autothrottle_enabled = !g_autothrottle_enabled;
-            
-            // Update button text and appearance
-            if (g_autothrottle_enabled) {
-                XPSetWidgetDescriptor(g_autothrottle_button, "ON");
-                // Note: XPWidgets doesn't directly support color changes, but we can use text to indicate state
-            } else {
-                XPSetWidgetDescriptor(g_autothrottle_button, "OFF");
-            }
+            SetAutothrottleEnabled(!g_autothrottle_enabled);
             return 1;
         }
     }
@@ -328,206 +714,915 @@ int WidgetCallback(XPWidgetMessage inMessage, XPWidgetID inWidget, intptr_t inPa
     return 0;
 }
 
-// Flight loop callback to update RPM label
-float FlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void* inRefcon) {
-    (void)inElapsedTimeSinceLastFlightLoop;
-    (void)inCounter;
-    (void)inRefcon;
+// Engage or disengage the autothrottle, update the button and wake the loop
+static void SetAutothrottleEnabled(bool enabled) {
+    if (enabled != g_autothrottle_enabled) {
+        BlackBoxRecordEvent(enabled ? BLACK_BOX_ENGAGE : BLACK_BOX_DISENGAGE, g_sim_time, (float)g_engine_state.target_rpm, 0.0f);
+    }
+    g_autothrottle_enabled = enabled;
+    if (!enabled) {
+        ReleaseThrottles();
+    }
+    
+    // Update button text and appearance
+    if (g_autothrottle_button) {
+        // Note: XPWidgets doesn't directly support color changes, but we can use text to indicate state
+        XPSetWidgetDescriptor(g_autothrottle_button, enabled ? "ON" : "OFF");
+    }
+    WakeFlightLoop();
+}
+
+// Hand the throttles back to X-Plane if the plugin overrode them
+static void ReleaseThrottles(void) {
+    if (g_owning_throttles) {
+        g_override_throttles_dataref.Set(0);
+        g_owning_throttles = false;
+    }
+}
+
+// Throttle the engines fly: the cockpit levers, or while the plugin owns
+// the throttles the values X-Plane uses
+static DataRef<float>& ThrottleDataref(void) {
+    return g_owning_throttles ? g_throttle_used_dataref : g_throttle_dataref;
+}
 
-    g_total_elapsed_time += inElapsedSinceLastCall;
+// Target a hold mode adjusts: the engine variable's, or a speed target
+static int TargetSlot(int mode) {
+    return (mode == AUTOTHROTTLE_MODE_ENGINE) ? g_variable : TARGET_IAS + mode - AUTOTHROTTLE_MODE_IAS;
+}
+
+// Target in its displayed units (RPM, percent, Nm, kg/h, knots or Mach)
+static float TargetValue(int slot) {
+    return (float)g_targets[slot] / TARGET_DEFINITIONS[slot].scale;
+}
+
+// Engine variable's target in control units
+static int EngineTargetControl(int variable) {
+    return (int)lroundf(TargetValue(variable) * VARIABLE_DEFINITIONS[variable].control_scale);
+}
+
+// Set a target in slider units (clamped to its range), sync the slider and
+// label if the selected mode adjusts it and wake the loop
+static void SetTarget(int slot, int target) {
+    const TargetDefinition& definition = TARGET_DEFINITIONS[slot];
+    if (target < definition.min) target = definition.min;
+    if (target > definition.max) target = definition.max;
     
-    UpdateRpmLabel();
-    UpdateThrottleLabel();
-    UpdateSliderValueLabel();
-    UpdateAutothrottle();
+    if (target != g_targets[slot]) {
+        // The slot's old and new values, in the units of its event
+        if (slot < ENGINE_VARIABLE_COUNT) {
+            float previous = (float)EngineTargetControl(slot);
+            g_targets[slot] = target;
+            BlackBoxRecordEvent(BLACK_BOX_TARGET, g_sim_time, previous, (float)EngineTargetControl(slot));
+        } else if (slot == TARGET_PROP_RPM) {
+            float previous = (float)g_targets[slot];
+            g_targets[slot] = target;
+            BlackBoxRecordEvent(BLACK_BOX_PROP_TARGET, g_sim_time, previous, (float)target);
+        } else {
+            float previous = TargetValue(slot);
+            g_targets[slot] = target;
+            BlackBoxRecordEvent(BLACK_BOX_SPEED_TARGET, g_sim_time, previous, TargetValue(slot));
+        }
+    }
+    if (slot == TargetSlot(g_mode)) {
+        if (g_rpm_slider) {
+            XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, target);
+        }
+        // Update label immediately
+        UpdateSliderValueLabel(target);
+    }
+    WakeFlightLoop();
+}
+
+// Hold one of the engine variable's presets (0 high, 1 low), with its prop
+// RPM in the constant-speed mode
+static void SelectPreset(int preset) {
+    const VariableDefinition& definition = VARIABLE_DEFINITIONS[g_variable];
+    SetMode(AUTOTHROTTLE_MODE_ENGINE);
+    SetTarget(g_variable, definition.presets[preset]);
+    if (definition.prop_presets[preset] > 0) {
+        SetTarget(TARGET_PROP_RPM, definition.prop_presets[preset]);
+    }
+}
+
+// Select the hold mode, re-range the slider and label for its target and
+// wake the loop. The controller carries on bumplessly from the target it
+// holds.
+static void SetMode(int mode) {
+    if (mode < 0 || mode >= AUTOTHROTTLE_MODE_COUNT) {
+        return;
+    }
+    if (mode != g_mode) {
+        BlackBoxRecordEvent(BLACK_BOX_MODE, g_sim_time, (float)EngineTargetControl(g_variable), (float)mode);
+    }
+    g_mode = mode;
     
-    return 0.1f;
+    const int slot = TargetSlot(mode);
+    const TargetDefinition& definition = TARGET_DEFINITIONS[slot];
+    if (g_mode_button) {
+        XPSetWidgetDescriptor(g_mode_button, MODE_NAMES[mode]);
+    }
+    if (g_rpm_slider) {
+        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarMin, definition.min);
+        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarMax, definition.max);
+        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarPageAmount, definition.step);
+        XPSetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, g_targets[slot]);
+    }
+    if (g_slider_value_label) {
+        BindLabel(&g_target_binding, g_slider_value_label, definition.label, definition.decimals, definition.units);
+        UpdateSliderValueLabel(g_targets[slot]);
+    }
+    WakeFlightLoop();
 }
 
-static void UpdateRpmLabel(void) {
-    if (!g_rpm_label) {
+// Select the engine variable the engine mode holds, recaption the window
+// for it and wake the loop. A new variable is a new plant, so the
+// controller re-engages bumplessly and the plant estimate starts over.
+static void SetVariable(int variable) {
+    if (variable < 0 || variable >= ENGINE_VARIABLE_COUNT) {
         return;
     }
+    if (variable != g_variable) {
+        BlackBoxRecordEvent(BLACK_BOX_VARIABLE, g_sim_time, (float)EngineTargetControl(g_variable), (float)variable);
+        g_autothrottle.engaged = false;
+        PlantEstimatorReset(&g_autothrottle.estimator);
+    }
+    g_variable = variable;
     
-    // Read current RPM value
-    float rpm_value = 0.0f;
-    if (g_rpm_dataref) {
-        XPLMDataTypeID rpm_type = XPLMGetDataRefTypes(g_rpm_dataref);
-        if (rpm_type & xplmType_FloatArray) {
-            float array_value[1];
-            if (XPLMGetDatavf(g_rpm_dataref, array_value, 0, 1) > 0) {
-                rpm_value = array_value[0];
-            }
-        } else if (rpm_type & xplmType_Float) {
-            rpm_value = XPLMGetDataf(g_rpm_dataref);
-        } else if (rpm_type & xplmType_Int) {
-            rpm_value = (float)XPLMGetDatai(g_rpm_dataref);
-        } else if (rpm_type & xplmType_IntArray) {
-            int array_value[1];
-            if (XPLMGetDatavi(g_rpm_dataref, array_value, 0, 1) > 0) {
-                rpm_value = (float)array_value[0];
-            }
+    const VariableDefinition& definition = VARIABLE_DEFINITIONS[variable];
+    const TargetDefinition& target = TARGET_DEFINITIONS[variable];
+    if (g_variable_button) {
+        XPSetWidgetDescriptor(g_variable_button, definition.name);
+    }
+    XPWidgetID presets[2] = { g_preset_high, g_preset_low };
+    for (int i = 0; i < 2; i++) {
+        if (presets[i]) {
+            char caption[16];
+            FormatFixed(caption, definition.presets[i], target.decimals);
+            XPSetWidgetDescriptor(presets[i], caption);
         }
     }
+    if (g_rpm_label) {
+        BindLabel(&g_rpm_binding, g_rpm_label, definition.label, target.decimals, target.units);
+    }
+    // Re-range the slider if it sets this variable's target
+    SetMode(g_mode);
+}
+
+// Hold what the user aircraft's engines are flown by: N1 for jets, torque
+// for turboprops, manifold pressure and prop RPM for pistons with
+// constant-speed props and RPM otherwise, from X-Plane's engine and prop
+// types
+static void SelectAircraftVariable(void) {
+    const int PROP_TYPE_CONSTANT_SPEED = 1;
+
+    switch (g_engine_type_dataref.Get()) {
+        case 2: // Free turbine
+        case 8: // Fixed turbine
+            SetVariable(ENGINE_VARIABLE_TORQUE);
+            break;
+        case 4: // Low bypass jet
+        case 5: // High bypass jet
+            SetVariable(ENGINE_VARIABLE_N1);
+            break;
+        default:
+            SetVariable((g_prop_type_dataref.Get() == PROP_TYPE_CONSTANT_SPEED) ? ENGINE_VARIABLE_MANIFOLD : ENGINE_VARIABLE_RPM);
+            break;
+    }
+}
+
+// Handler for the xpautothrottle/ commands. Acts on the press only.
+static int CommandHandler(XPLMCommandRef inCommand, XPLMCommandPhase inPhase, void* inRefcon) {
+    (void)inCommand;
     
-    char rpm_text[256];
-    if (g_rpm_dataref) {
-        snprintf(rpm_text, sizeof(rpm_text), "RPM: %.0f", rpm_value);
-    } else {
-        snprintf(rpm_text, sizeof(rpm_text), "RPM: INVALID");
+    if (inPhase != xplm_CommandBegin) {
+        return 0;
     }
+    
+    const CommandAction action = (CommandAction)(intptr_t)inRefcon;
+    switch (action) {
+        case COMMAND_TOGGLE:
+            SetAutothrottleEnabled(!g_autothrottle_enabled);
+            break;
+        case COMMAND_ENGAGE:
+            SetAutothrottleEnabled(true);
+            break;
+        case COMMAND_DISENGAGE:
+            SetAutothrottleEnabled(false);
+            break;
+        case COMMAND_TARGET_UP:
+        case COMMAND_TARGET_DOWN: {
+            const int slot = TargetSlot(g_mode);
+            const int step = TARGET_DEFINITIONS[slot].step;
+            SetTarget(slot, g_targets[slot] + ((action == COMMAND_TARGET_UP) ? step : -step));
+            break;
+        }
+        case COMMAND_PROP_UP:
+        case COMMAND_PROP_DOWN: {
+            const int step = TARGET_DEFINITIONS[TARGET_PROP_RPM].step;
+            SetTarget(TARGET_PROP_RPM, g_targets[TARGET_PROP_RPM] + ((action == COMMAND_PROP_UP) ? step : -step));
+            break;
+        }
+        case COMMAND_PRESET_HIGH:
+        case COMMAND_PRESET_2400:
+            SelectPreset(0);
+            break;
+        case COMMAND_PRESET_LOW:
+        case COMMAND_PRESET_1000:
+            SelectPreset(1);
+            break;
+        case COMMAND_MODE_ENGINE:
+        case COMMAND_MODE_RPM:
+            SetMode(AUTOTHROTTLE_MODE_ENGINE);
+            break;
+        case COMMAND_MODE_IAS:
+            SetMode(AUTOTHROTTLE_MODE_IAS);
+            break;
+        case COMMAND_MODE_MACH:
+            SetMode(AUTOTHROTTLE_MODE_MACH);
+            break;
+        case COMMAND_VARIABLE_RPM:
+        case COMMAND_VARIABLE_N1:
+        case COMMAND_VARIABLE_TORQUE:
+        case COMMAND_VARIABLE_EPR:
+        case COMMAND_VARIABLE_FUEL_FLOW:
+        case COMMAND_VARIABLE_MANIFOLD:
+            SetVariable(action - COMMAND_VARIABLE_RPM);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
 
-    XPSetWidgetDescriptor(g_rpm_label, rpm_text);
+static int ReadEngaged(void* refcon) {
+    (void)refcon;
+    return g_autothrottle_enabled ? 1 : 0;
 }
 
-static void UpdateThrottleLabel(void) {
-    if (!g_throttle_label) {
-        return;
+static void WriteEngaged(void* refcon, int value) {
+    (void)refcon;
+    if ((value != 0) != g_autothrottle_enabled) {
+        SetAutothrottleEnabled(value != 0);
+    }
+}
+
+static int ReadTargetRpmInt(void* refcon) {
+    (void)refcon;
+    return g_targets[ENGINE_VARIABLE_RPM];
+}
+
+static void WriteTargetRpmInt(void* refcon, int value) {
+    (void)refcon;
+    if (value != g_targets[ENGINE_VARIABLE_RPM]) {
+        SetTarget(ENGINE_VARIABLE_RPM, value);
     }
+}
+
+static float ReadTargetRpmFloat(void* refcon) {
+    (void)refcon;
+    return (float)g_targets[ENGINE_VARIABLE_RPM];
+}
+
+static void WriteTargetRpmFloat(void* refcon, float value) {
+    WriteTargetRpmInt(refcon, (int)lroundf(value));
+}
+
+// Array read over one of the cached per-engine arrays (the refcon). A null
+// buffer asks for the size, which is the engine count.
+static int ReadEngineArray(void* refcon, float* values, int offset, int max) {
+    const float* source = static_cast<const float*>(refcon);
+    if (!values) {
+        return g_published_num_engines;
+    }
+    if (offset < 0 || offset >= g_published_num_engines) {
+        return 0;
+    }
+    int count = (g_published_num_engines - offset < max) ? g_published_num_engines - offset : max;
+    for (int i = 0; i < count; i++) {
+        values[i] = source[offset + i];
+    }
+    return count;
+}
+
+static int ReadAdaptive(void* refcon) {
+    (void)refcon;
+    return g_autothrottle.adaptive ? 1 : 0;
+}
+
+static void WriteAdaptive(void* refcon, int value) {
+    (void)refcon;
+    g_autothrottle.adaptive = value != 0;
+}
+
+static int ReadOwnThrottles(void* refcon) {
+    (void)refcon;
+    return g_own_throttles ? 1 : 0;
+}
+
+static void WriteOwnThrottles(void* refcon, int value) {
+    (void)refcon;
+    g_own_throttles = value != 0;
+}
+
+static int ReadMode(void* refcon) {
+    (void)refcon;
+    return g_mode;
+}
+
+static void WriteMode(void* refcon, int value) {
+    (void)refcon;
+    if (value != g_mode) {
+        SetMode(value);
+    }
+}
+
+static int ReadVariable(void* refcon) {
+    (void)refcon;
+    return g_variable;
+}
+
+// Units of the engine variable as a string. A null buffer asks for the
+// length, including the terminator.
+static int ReadErrorUnits(void* refcon, void* values, int offset, int max) {
+    (void)refcon;
+    const char* units = VARIABLE_DEFINITIONS[g_variable].units;
+    int length = (int)strlen(units) + 1;
+    if (!values) {
+        return length;
+    }
+    if (offset < 0 || offset >= length) {
+        return 0;
+    }
+    int count = (length - offset < max) ? length - offset : max;
+    memcpy(values, units + offset, count);
+    return count;
+}
+
+static void WriteVariable(void* refcon, int value) {
+    (void)refcon;
+    if (value != g_variable) {
+        SetVariable(value);
+    }
+}
+
+// Refcon of the target dataref that follows the selected engine variable
+const intptr_t TARGET_REFCON_VARIABLE = -1;
+
+// Target slot named by a target dataref's refcon
+static int RefconSlot(void* refcon) {
+    intptr_t slot = (intptr_t)refcon;
+    return (slot == TARGET_REFCON_VARIABLE) ? g_variable : (int)slot;
+}
+
+// Target of the slot in the refcon, in its displayed units
+static float ReadTargetValue(void* refcon) {
+    return TargetValue(RefconSlot(refcon));
+}
+
+static void WriteTargetValue(void* refcon, float value) {
+    int slot = RefconSlot(refcon);
+    int target = (int)lroundf(value * TARGET_DEFINITIONS[slot].scale);
+    if (target != g_targets[slot]) {
+        SetTarget(slot, target);
+    }
+}
+
+// Read of one cached float (the refcon)
+static float ReadPublishedFloat(void* refcon) {
+    return *static_cast<const float*>(refcon);
+}
+
+// Publish the controller state as datarefs under xpautothrottle/. The
+// engaged state and target are writable so external panels can drive the
+// autothrottle without the window.
+static void RegisterStateDatarefs(void) {
+    g_engaged_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/engaged", xplmType_Int, 1,
+        ReadEngaged, WriteEngaged,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_target_rpm_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/target_rpm", xplmType_Int | xplmType_Float, 1,
+        ReadTargetRpmInt, WriteTargetRpmInt,
+        ReadTargetRpmFloat, WriteTargetRpmFloat,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_error_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/error", xplmType_FloatArray, 0,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        ReadEngineArray, nullptr,
+        nullptr, nullptr,
+        g_published_error, nullptr);
+    g_error_units_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/error_units", xplmType_Data, 0,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        ReadErrorUnits, nullptr,
+        nullptr, nullptr);
+    // The error under its original name, for panels written before the
+    // engine variables; it is in error_units like error itself
+    g_rpm_error_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/rpm_error", xplmType_FloatArray, 0,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        ReadEngineArray, nullptr,
+        nullptr, nullptr,
+        g_published_error, nullptr);
+    g_commanded_throttle_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/commanded_throttle", xplmType_FloatArray, 0,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        ReadEngineArray, nullptr,
+        nullptr, nullptr,
+        g_published_commanded_throttle, nullptr);
+    g_adaptive_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/adaptive", xplmType_Int, 1,
+        ReadAdaptive, WriteAdaptive,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_own_throttles_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/own_throttles", xplmType_Int, 1,
+        ReadOwnThrottles, WriteOwnThrottles,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_mode_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/mode", xplmType_Int, 1,
+        ReadMode, WriteMode,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_target_ias_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/target_ias", xplmType_Float, 1,
+        nullptr, nullptr,
+        ReadTargetValue, WriteTargetValue,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        (void*)(intptr_t)TARGET_IAS, (void*)(intptr_t)TARGET_IAS);
+    g_target_mach_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/target_mach", xplmType_Float, 1,
+        nullptr, nullptr,
+        ReadTargetValue, WriteTargetValue,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        (void*)(intptr_t)TARGET_MACH, (void*)(intptr_t)TARGET_MACH);
+    g_target_prop_rpm_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/target_prop_rpm", xplmType_Float, 1,
+        nullptr, nullptr,
+        ReadTargetValue, WriteTargetValue,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        (void*)(intptr_t)TARGET_PROP_RPM, (void*)(intptr_t)TARGET_PROP_RPM);
+    g_target_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/target", xplmType_Float, 1,
+        nullptr, nullptr,
+        ReadTargetValue, WriteTargetValue,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        (void*)TARGET_REFCON_VARIABLE, (void*)TARGET_REFCON_VARIABLE);
+    g_variable_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/variable", xplmType_Int, 1,
+        ReadVariable, WriteVariable,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr);
+    g_speed_error_dataref = XPLMRegisterDataAccessor(
+        "xpautothrottle/speed_error", xplmType_Float, 0,
+        nullptr, nullptr,
+        ReadPublishedFloat, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        &g_published_speed_error, nullptr);
     
-    // Read current throttle value
-    float throttle_value = 0.0f;
-    if (g_throttle_dataref) {
-        XPLMDataTypeID throttle_type = XPLMGetDataRefTypes(g_throttle_dataref);
-        if (throttle_type & xplmType_FloatArray) {
-            float array_value[1];
-            if (XPLMGetDatavf(g_throttle_dataref, array_value, 0, 1) > 0) {
-                throttle_value = array_value[0];
-            }
-        } else {
-            throttle_value = XPLMGetDataf(g_throttle_dataref);
+    const struct {
+        const char* name;
+        float* value;
+    } plant_values[] = {
+        { "xpautothrottle/plant/gain", &g_published_plant.gain },
+        { "xpautothrottle/plant/time_constant", &g_published_plant.time_constant },
+        { "xpautothrottle/plant/dead_time", &g_published_plant.dead_time },
+        { "xpautothrottle/kp", &g_published_gains.kp },
+        { "xpautothrottle/ki", &g_published_gains.ki },
+    };
+    for (int i = 0; i < 5; i++) {
+        g_plant_datarefs[i] = XPLMRegisterDataAccessor(
+            plant_values[i].name, xplmType_Float, 0,
+            nullptr, nullptr,
+            ReadPublishedFloat, nullptr,
+            nullptr, nullptr,
+            nullptr, nullptr,
+            nullptr, nullptr,
+            nullptr, nullptr,
+            plant_values[i].value, nullptr);
+    }
+}
+
+static void UnregisterStateDatarefs(void) {
+    XPLMDataRef* datarefs[] = {
+        &g_engaged_dataref, &g_target_rpm_dataref, &g_error_dataref, &g_error_units_dataref, &g_rpm_error_dataref,
+        &g_commanded_throttle_dataref,
+        &g_adaptive_dataref, &g_own_throttles_dataref, &g_mode_dataref, &g_target_ias_dataref, &g_target_mach_dataref,
+        &g_target_prop_rpm_dataref,
+        &g_speed_error_dataref, &g_target_dataref, &g_variable_dataref, &g_plant_datarefs[0], &g_plant_datarefs[1], &g_plant_datarefs[2],
+        &g_plant_datarefs[3], &g_plant_datarefs[4]
+    };
+    for (XPLMDataRef* dataref : datarefs) {
+        if (*dataref) {
+            XPLMUnregisterDataAccessor(*dataref);
+            *dataref = nullptr;
         }
     }
+}
+
+// Schedule the flight loop for the next frame, e.g. after the window is shown
+// or the autothrottle is engaged while the loop is suspended
+static void WakeFlightLoop(void) {
+    if (g_flight_loop) {
+        XPLMScheduleFlightLoop(g_flight_loop, LOOP_INTERVAL_EVERY_FRAME, 1);
+    }
+}
+
+// Schedule the label refresh for the next frame, after the window is shown
+static void WakeUiLoop(void) {
+    if (g_ui_flight_loop) {
+        XPLMScheduleFlightLoop(g_ui_flight_loop, LOOP_INTERVAL_EVERY_FRAME, 1);
+    }
+}
+
+// Label refresh from the last sampled state, at a low rate while the
+// window is visible
+float UiLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void* inRefcon) {
+    (void)inElapsedSinceLastCall;
+    (void)inElapsedTimeSinceLastFlightLoop;
+    (void)inCounter;
+    (void)inRefcon;
+
+    if (!g_main_window || !XPIsWidgetVisible(g_main_window)) {
+        return LOOP_INTERVAL_SUSPENDED;
+    }
+    {
+        ProfileScope scope(PROFILE_RPM_LABEL);
+        UpdateRpmLabel(g_engine_state);
+    }
+    {
+        ProfileScope scope(PROFILE_THROTTLE_LABEL);
+        UpdateThrottleLabel(g_engine_state);
+    }
+    {
+        ProfileScope scope(PROFILE_SLIDER_LABEL);
+        UpdateSliderValueLabel(g_targets[TargetSlot(g_mode)]);
+    }
+    return LOOP_INTERVAL_UI;
+}
+
+// Control loop callback: samples the engines before the flight model and
+// runs the autothrottle, so its throttle write is flown this frame. Runs
+// every frame while correcting, at a low rate while the window is visible
+// (keeping the sampled state fresh for the labels) or the autothrottle is
+// holding, and is suspended otherwise. The low rate is in sim time, and
+// while the sim is paused or replaying only the state is sampled.
+float FlightLoopCallback(float inElapsedSinceLastCall, float inElapsedTimeSinceLastFlightLoop, int inCounter, void* inRefcon) {
+    (void)inElapsedTimeSinceLastFlightLoop;
+    (void)inCounter;
+    (void)inRefcon;
+
+    ProfilerAdvance(inElapsedSinceLastCall);
+    ProfileScope total_scope(PROFILE_TOTAL);
+    
+    // Without the sim clock, fall back to the frame clock
+    const double previous_time = g_sim_time;
+    g_sim_time = g_sim_time_dataref.IsValid() ? (double)g_sim_time_dataref.Get() : g_sim_time + inElapsedSinceLastCall;
+    double elapsed = fmax(g_sim_time - previous_time, 0.0);
+    const float sim_rate = (inElapsedSinceLastCall > 0.0f) ? (float)(elapsed / inElapsedSinceLastCall) : 1.0f;
+    if (g_loop_resuming) {
+        elapsed = fmin(elapsed, (double)MAX_RESUME_DT);
+    }
+    {
+        ProfileScope scope(PROFILE_SAMPLE);
+        SampleEngineState(&g_engine_state, (float)elapsed);
+    }
+    
+    const bool window_visible = g_main_window && XPIsWidgetVisible(g_main_window);
+    const bool replay = g_replay_dataref.Get() != 0;
+    if (replay || g_paused_dataref.Get() != 0) {
+        // A replay flies the recorded throttles, so hand them back and
+        // pick up from wherever it leaves them
+        if (replay) {
+            g_autothrottle.engaged = false;
+            ReleaseThrottles();
+        }
+        g_loop_resuming = true;
+        return (g_autothrottle_enabled || window_visible) ? LOOP_INTERVAL_IDLE : LOOP_INTERVAL_SUSPENDED;
+    }
+    g_loop_resuming = false;
+    
+    bool correcting;
+    {
+        ProfileScope scope(PROFILE_AUTOTHROTTLE);
+        correcting = UpdateAutothrottle(g_engine_state);
+    }
+    
+    // Errors against the engine target the loop is holding, which the
+    // speed modes set, in the variable's displayed units
+    const float rpm_target = (g_engine_state.mode == AUTOTHROTTLE_MODE_ENGINE || !g_autothrottle.engaged) ?
+                             (float)g_engine_state.target_rpm : g_autothrottle.rpm_setpoint;
+    const float control_scale = VARIABLE_DEFINITIONS[g_variable].control_scale;
+    g_published_num_engines = g_engine_state.num_engines;
+    for (int i = 0; i < g_engine_state.num_engines; i++) {
+        g_published_error[i] = (rpm_target - g_engine_state.rpm[i]) / control_scale;
+    }
+    g_published_speed_error = SpeedErrorKt(g_engine_state);
+    {
+        ProfileScope scope(PROFILE_RECORD);
+        RecordSample(g_engine_state);
+    }
+    
+    if (correcting) {
+        return LOOP_INTERVAL_EVERY_FRAME;
+    }
+    if (g_autothrottle_enabled || window_visible) {
+        return LOOP_INTERVAL_IDLE / fmaxf(sim_rate, 1.0f);
+    }
+    g_loop_resuming = true;
+    return LOOP_INTERVAL_SUSPENDED;
+}
+
+// Read the datarefs and target once for this tick
+static void SampleEngineState(EngineState* state, float elapsed) {
+    // One array read per dataref covers every engine. The controlled
+    // variable is scaled into control units, so the core sees RPM-like
+    // magnitudes whatever is held.
+    const VariableDefinition& variable = VARIABLE_DEFINITIONS[g_variable];
+    DataRef<float>& variable_dataref = g_engine_datarefs[g_variable];
+    int rpm_count = variable_dataref.GetArray(state->rpm, 0, g_num_engines);
+    const float scale = variable.dataref_scale * variable.control_scale;
+    for (int i = 0; i < rpm_count; i++) {
+        state->rpm[i] *= scale;
+    }
+    DataRef<float>& throttle_dataref = ThrottleDataref();
+    int throttle_count = throttle_dataref.GetArray(state->throttle, 0, g_num_engines);
+    state->num_engines = (rpm_count < throttle_count) ? rpm_count : throttle_count;
+    state->rpm_valid = variable_dataref.IsValid() && rpm_count > 0;
+    state->throttle_valid = throttle_dataref.IsValid() && throttle_count > 0;
+    state->mode = g_mode;
+    state->target_rpm = EngineTargetControl(g_variable);
+    state->target_ias_kt = TargetValue(TARGET_IAS);
+    state->target_mach = TargetValue(TARGET_MACH);
+    
+    // Constant-speed prop: the lever loop's target and inputs
+    state->target_prop_rpm = 0;
+    state->prop_valid = false;
+    if (variable.prop_presets[0] > 0) {
+        state->target_prop_rpm = g_targets[TARGET_PROP_RPM];
+        int prop_rpm_count = g_prop_rpm_dataref.GetArray(state->prop_rpm, 0, state->num_engines);
+        int prop_lever_count = g_prop_lever_dataref.GetArray(state->prop_lever, 0, state->num_engines);
+        state->prop_valid = g_prop_lever_dataref.IsWritable() &&
+                            prop_rpm_count == state->num_engines && prop_lever_count == state->num_engines;
+    }
+    
+    // Flight condition for the gain schedule; sea level at rest if the
+    // air data is unavailable
+    float density = g_air_density_dataref.Get();
+    state->density_altitude_ft = (density > 0.0f) ? DensityAltitudeFt(density / SEA_LEVEL_DENSITY) : 0.0f;
+    state->indicated_airspeed_kt = g_indicated_airspeed_dataref.Get();
+    state->mach = g_mach_dataref.Get();
+    state->sample_time = (float)g_sim_time;
+    state->dt = elapsed;
+}
+
+static void UpdateRpmLabel(const EngineState& state) {
+    // Show the mean across engines; the autothrottle holds each engine on target
+    float rpm_sum = 0.0f;
+    for (int i = 0; i < state.num_engines; i++) {
+        rpm_sum += state.rpm[i];
+    }
+    float rpm_value = (state.num_engines > 0) ? rpm_sum / state.num_engines : 0.0f;
+    
+    // Quantize to the displayed decimals, as for the target
+    const float scale = TARGET_DEFINITIONS[g_variable].scale / VARIABLE_DEFINITIONS[g_variable].control_scale;
+    UpdateLabel(&g_rpm_binding, state.rpm_valid, (int)lroundf(rpm_value * scale));
+}
+
+static void UpdateThrottleLabel(const EngineState& state) {
+    float throttle_sum = 0.0f;
+    for (int i = 0; i < state.num_engines; i++) {
+        throttle_sum += state.throttle[i];
+    }
+    float throttle_value = (state.num_engines > 0) ? throttle_sum / state.num_engines : 0.0f;
     
     // Clamp throttle value to valid range (0.0-1.0) and convert to percentage
     if (throttle_value < 0.0f) throttle_value = 0.0f;
     if (throttle_value > 1.0f) throttle_value = 1.0f;
     float throttle_percent = throttle_value * 100.0f; // Convert to percentage
     
-    char throttle_text[256];
-    if (g_throttle_dataref) {
-        snprintf(throttle_text, sizeof(throttle_text), "Throttle: %.1f%%", throttle_percent);
-    } else {
-        snprintf(throttle_text, sizeof(throttle_text), "Throttle: INVALID");
-    }
+    // Displayed with one decimal, so quantize to tenths of a percent
+    UpdateLabel(&g_throttle_binding, state.throttle_valid, (int)lroundf(throttle_percent * 10.0f));
+}
 
-    XPSetWidgetDescriptor(g_throttle_label, throttle_text);
+// Full path of a file in the X-Plane Output directory
+static void OutputPath(char* path, size_t size, const char* file_name) {
+    XPLMGetSystemPath(path);
+    size_t length = strlen(path);
+    snprintf(path + length, size - length, "Output%s%s", XPLMGetDirectorySeparator(), file_name);
 }
 
-// Update slider value label to show current target RPM
-static void UpdateSliderValueLabel(void) {
-    if (!g_slider_value_label || !g_rpm_slider) {
-        return;
+// Open a new flight log in the X-Plane Output directory, named by the
+// local start time
+static void StartRecorder(void) {
+    char file_name[64];
+    time_t now = time(nullptr);
+    strftime(file_name, sizeof(file_name), "xpautothrottle_%Y%m%d_%H%M%S.xatlog", localtime(&now));
+    
+    char path[1024];
+    OutputPath(path, sizeof(path), file_name);
+    
+    if (!RecorderStart(path)) {
+        char message[1100];
+        snprintf(message, sizeof(message), "XPAutoThrottle: could not create flight log %s\n", path);
+        XPLMDebugString(message);
     }
+}
+
+// Map the black box in the X-Plane Output directory, keeping the previous
+// session's file for post-mortems
+static void OpenBlackBox(void) {
+    char path[1024];
+    char previous_path[1024];
+    OutputPath(path, sizeof(path), "xpautothrottle_blackbox.bin");
+    OutputPath(previous_path, sizeof(previous_path), "xpautothrottle_blackbox.prev.bin");
     
-    int slider_value = (int)XPGetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, NULL);
-    char label_text[256];
-    snprintf(label_text, sizeof(label_text), "Target RPM: %d", slider_value);
-    XPSetWidgetDescriptor(g_slider_value_label, label_text);
+    if (!BlackBoxOpen(path, previous_path)) {
+        char message[1100];
+        snprintf(message, sizeof(message), "XPAutoThrottle: could not map black box %s\n", path);
+        XPLMDebugString(message);
+    }
 }
 
-// Autothrottle function: adjusts throttle to maintain target RPM
-static void UpdateAutothrottle(void) {
-    // Check if autothrottle is enabled
-    if (!g_autothrottle_enabled) {
-        g_rpm_out_of_tolerance_start_time = -1.0f; // Reset timing when disabled
+// Use the tuned gain profile shipped in the user aircraft's folder, if any,
+// else the defaults
+static void LoadAircraftGains(void) {
+    char file_name[256];
+    char path[1024];
+    XPLMGetNthAircraftModel(0, file_name, path);
+    
+    g_gain_profile = DefaultGainProfile();
+    char* separator = strrchr(path, XPLMGetDirectorySeparator()[0]);
+    if (!separator) {
         return;
     }
+    size_t length = (size_t)(separator + 1 - path);
+    snprintf(separator + 1, sizeof(path) - length, "%s", GAIN_PROFILE_FILE_NAME);
     
-    // Check if we have all required datarefs and widgets
-    if (!g_rpm_dataref || !g_throttle_dataref || !g_rpm_slider) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
         return;
     }
+    fclose(file);
     
-    // Get target RPM from slider
-    int target_rpm = (int)XPGetWidgetProperty(g_rpm_slider, xpProperty_ScrollBarSliderPosition, NULL);
+    char message[1200];
+    if (LoadGainProfile(path, &g_gain_profile)) {
+        const PidGains& gains = g_gain_profile.gains;
+        snprintf(message, sizeof(message), "XPAutoThrottle: loaded gains kp %g ki %g kd %g, %dx%d schedule from %s\n",
+                 gains.kp, gains.ki, gains.kd, g_gain_profile.schedule.altitude_count,
+                 g_gain_profile.schedule.airspeed_count, path);
+    } else {
+        snprintf(message, sizeof(message), "XPAutoThrottle: ignoring invalid gain profile %s\n", path);
+    }
+    XPLMDebugString(message);
+}
+
+// Queue this tick for the flight recorder and the black box
+static void RecordSample(const EngineState& state) {
+    FlightLogSample sample;
+    sample.sample_time = state.sample_time;
+    sample.dt = state.dt;
+    const bool speed_hold = g_autothrottle_enabled && g_autothrottle.engaged && state.mode != AUTOTHROTTLE_MODE_ENGINE;
+    sample.target_rpm = speed_hold ? g_autothrottle.rpm_setpoint : (float)state.target_rpm;
+    sample.num_engines = (uint8_t)state.num_engines;
+    sample.density_altitude_ft = state.density_altitude_ft;
+    sample.indicated_airspeed_kt = state.indicated_airspeed_kt;
+    sample.flags = (g_autothrottle_enabled ? FLIGHT_LOG_ENGAGED : 0) |
+                   (g_autothrottle.adaptive ? FLIGHT_LOG_ADAPTIVE : 0) |
+                   (speed_hold ? FLIGHT_LOG_SPEED_HOLD : 0) |
+                   (state.rpm_valid ? FLIGHT_LOG_RPM_VALID : 0) |
+                   (state.throttle_valid ? FLIGHT_LOG_THROTTLE_VALID : 0);
+    sample.variable = (uint8_t)g_variable;
+    sample.target_prop_rpm = (float)state.target_prop_rpm;
+    for (int i = 0; i < state.num_engines; i++) {
+        sample.rpm[i] = state.rpm[i];
+        sample.throttle[i] = state.throttle[i];
+        sample.commanded_throttle[i] = g_published_commanded_throttle[i];
+    }
+    RecorderPush(sample);
+    BlackBoxRecordSample(sample);
+}
+
+// Update slider value label to show the selected mode's target
+static void UpdateSliderValueLabel(int target) {
+    UpdateLabel(&g_target_binding, true, target);
+}
+
+// Autothrottle function: runs the control law for each engine and writes
+// the throttles. Returns true while any engine is outside the RPM tolerance,
+// in the speed modes the airspeed is outside its tolerance, or the levers
+// are still moving to the command, so the loop keeps running every frame.
+static bool UpdateAutothrottle(const EngineState& state) {
+    const float THROTTLE_STEP_EVENT = 0.05f; // Commanded step logged to the black box
     
-    // Get current RPM from dataref
-    float current_rpm = 0.0f;
-    XPLMDataTypeID rpm_type = XPLMGetDataRefTypes(g_rpm_dataref);
-    if (rpm_type & xplmType_FloatArray) {
-        float array_value[1];
-        if (XPLMGetDatavf(g_rpm_dataref, array_value, 0, 1) > 0) {
-            current_rpm = array_value[0];
-        }
-    } else if (rpm_type & xplmType_Float) {
-        current_rpm = XPLMGetDataf(g_rpm_dataref);
-    } else if (rpm_type & xplmType_Int) {
-        current_rpm = (float)XPLMGetDatai(g_rpm_dataref);
-    } else if (rpm_type & xplmType_IntArray) {
-        int array_value[1];
-        if (XPLMGetDatavi(g_rpm_dataref, array_value, 0, 1) > 0) {
-            current_rpm = (float)array_value[0];
-        }
+    PidGains gains = GainScheduleApply(g_gain_profile.schedule, g_gain_profile.gains,
+                                       state.density_altitude_ft, state.indicated_airspeed_kt);
+    // The profile's speed loop range is in RPM; other variables range the
+    // speed loop over their own target range in control units
+    SpeedGains speed = g_gain_profile.speed;
+    if (g_variable != ENGINE_VARIABLE_RPM) {
+        const TargetDefinition& target = TARGET_DEFINITIONS[g_variable];
+        const float control_scale = VARIABLE_DEFINITIONS[g_variable].control_scale;
+        speed.rpm_min = (float)target.min / target.scale * control_scale;
+        speed.rpm_max = (float)target.max / target.scale * control_scale;
+    }
+    AutothrottleAction action = AutothrottleStep(&g_autothrottle, state, g_autothrottle_enabled, gains, speed, g_gain_profile.prop,
+                                                 g_gain_profile.actuator);
+    g_published_plant = PlantEstimatorModel(g_autothrottle.estimator);
+    g_published_gains = g_autothrottle.gains;
+    if (action == AUTOTHROTTLE_OFF) {
+        return false;
     }
     
-    // Get current throttle position
-    float current_throttle = 0.0f;
-    XPLMDataTypeID throttle_type = XPLMGetDataRefTypes(g_throttle_dataref);
-    if (throttle_type & xplmType_FloatArray) {
-        float array_value[1];
-        if (XPLMGetDatavf(g_throttle_dataref, array_value, 0, 1) > 0) {
-            current_throttle = array_value[0];
+    const float* output = g_autothrottle.actuator.position;
+    if (action == AUTOTHROTTLE_OVERRIDDEN) {
+        // Take the throttles over from an axis fighting the autothrottle,
+        // carrying on from where it left them; otherwise the pilot wins
+        const bool take_over = g_own_throttles && !g_owning_throttles && g_override_throttles_dataref.IsWritable() &&
+                               g_throttle_used_dataref.IsWritable();
+        BlackBoxRecordEvent(BLACK_BOX_PILOT_OVERRIDE, state.sample_time, g_autothrottle.rpm_setpoint, take_over ? 1.0f : 0.0f);
+        if (take_over) {
+            g_override_throttles_dataref.Set(1);
+            g_owning_throttles = true;
+            g_throttle_used_dataref.SetArray(output, 0, state.num_engines);
+            XPLMDebugString("XPAutoThrottle: throttles moved while engaged, overriding X-Plane's throttles\n");
+        } else {
+            SetAutothrottleEnabled(false);
+            XPLMDebugString("XPAutoThrottle: throttles moved while engaged, disengaging\n");
         }
-    } else {
-        current_throttle = XPLMGetDataf(g_throttle_dataref);
     }
-   
-    float rpm_diff = (float)target_rpm - current_rpm;
-    
-    const float RPM_TOLERANCE = 15.0f; // Keep it within 15 RPM of the target RPM
-    const float THROTTLE_ADJUSTMENT = 0.001f; // Adjust by 0.5% for every 100 RPM off target
-    const float SETTLE_TIME = 2.0f; // Wait 2 seconds before any adjustment
-    const float MIN_ADJUST_INTERVAL = 1.0f; // Only adjust once per second
-    
-    if (rpm_diff > RPM_TOLERANCE || rpm_diff < -RPM_TOLERANCE) {
-        if (g_rpm_out_of_tolerance_start_time < 0.0f) {
-            g_rpm_out_of_tolerance_start_time = g_total_elapsed_time;
+    if (action == AUTOTHROTTLE_COMMAND) {
+        ThrottleDataref().SetArray(output, 0, state.num_engines);
+        if (g_autothrottle.prop_engaged) {
+            g_prop_lever_dataref.SetArray(g_autothrottle.prop.output, 0, state.num_engines);
         }
         
-        float time_out_of_tolerance = g_total_elapsed_time - g_rpm_out_of_tolerance_start_time;
-        float time_since_last_adjust = g_total_elapsed_time - g_last_throttle_adjust_time;
-        
-        if (time_out_of_tolerance >= SETTLE_TIME && time_since_last_adjust >= MIN_ADJUST_INTERVAL) {
-            float abs_rpm_diff = (rpm_diff > 0.0f) ? rpm_diff : -rpm_diff;
-            int hundred_rpm_units = (int)(abs_rpm_diff / 100.0f);
-            float dynamic_adjustment = THROTTLE_ADJUSTMENT;
-            
-            for (int i = 0; i < hundred_rpm_units; i++) {
-                dynamic_adjustment *= 2.0f;
-            }
-
-            const float MAX_ADJUSTMENT = 0.1f;
-            if (dynamic_adjustment > MAX_ADJUSTMENT) {
-                dynamic_adjustment = MAX_ADJUSTMENT;
-            }
-
-            float new_throttle = current_throttle;
-            
-            if (rpm_diff > RPM_TOLERANCE) {
-                new_throttle = current_throttle + dynamic_adjustment;
-                if (new_throttle > 1.0f) {
-                    new_throttle = 1.0f;
-                }
-            } else if (rpm_diff < -RPM_TOLERANCE) {
-                new_throttle = current_throttle - dynamic_adjustment;
-                if (new_throttle < 0.0f) {
-                    new_throttle = 0.0f;
-                }
-            }
-            
-            if (new_throttle != current_throttle) {
-                XPLMDataTypeID throttle_write_type = XPLMGetDataRefTypes(g_throttle_dataref);
-                if (throttle_write_type & xplmType_FloatArray) {
-                    float array_value[1] = { new_throttle };
-                    XPLMSetDatavf(g_throttle_dataref, array_value, 0, 1);
-                } else {
-                    XPLMSetDataf(g_throttle_dataref, new_throttle);
-                }
-                g_last_throttle_adjust_time = g_total_elapsed_time;
-            }
+        float largest_step = 0.0f;
+        for (int i = 0; i < state.num_engines; i++) {
+            largest_step = fmaxf(largest_step, fabsf(output[i] - g_published_commanded_throttle[i]));
+        }
+        if (largest_step > THROTTLE_STEP_EVENT) {
+            BlackBoxRecordEvent(BLACK_BOX_THROTTLE_STEP, state.sample_time, g_autothrottle.rpm_setpoint, largest_step);
         }
-    } else {
-        g_rpm_out_of_tolerance_start_time = -1.0f;
     }
+    for (int i = 0; i < state.num_engines; i++) {
+        g_published_commanded_throttle[i] = output[i];
+    }
+    
+    return AutothrottleOutOfTolerance(g_autothrottle, state) || AutothrottleActuating(g_autothrottle);
 }
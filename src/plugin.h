@@ -1,7 +1,34 @@
 #ifndef PLUGIN_H
 #define PLUGIN_H
 
-// This header file can be used for shared declarations if needed
+// Maximum number of engines X-Plane simulates per aircraft
+const int MAX_ENGINES = 16;
 
-#endif // PLUGIN_H
+// Engine state sampled once per flight loop tick. The label updaters and the
+// autothrottle both read from this so they always see the same sample.
+// Per-engine values are stored as arrays so the control loop can run over
+// all engines at once. The controlled variable is RPM, or for turbines an
+// indicator (N1, torque, EPR, fuel flow) scaled into control units that
+// span about the same range, so one set of gains fits roughly either way.
+struct EngineState {
+    float rpm[MAX_ENGINES];         // Controlled variable per engine (control units)
+    float throttle[MAX_ENGINES];    // Throttle ratio per engine (0.0-1.0)
+    int num_engines;        // Engines on the current aircraft
+    float sample_time;      // Plugin time of this sample (seconds)
+    float dt;               // Time since the previous sample (seconds)
+    int target_rpm;         // Engine target (control units)
+    float density_altitude_ft;      // Flight condition for the gain schedule
+    float indicated_airspeed_kt;
+    float mach;             // Mach number
+    int mode;               // AutothrottleMode selected
+    float target_ias_kt;    // Speed targets for the speed modes
+    float target_mach;
+    bool rpm_valid;         // Controlled variable dataref resolved
+    bool throttle_valid;    // Throttle dataref resolved
+    int target_prop_rpm;    // Constant-speed prop target (RPM), 0 without a prop loop
+    float prop_rpm[MAX_ENGINES];    // Prop speed per engine (RPM)
+    float prop_lever[MAX_ENGINES];  // Prop lever per engine (0.0-1.0)
+    bool prop_valid;        // Prop datarefs resolved
+};
 
+#endif // PLUGIN_H
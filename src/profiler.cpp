@@ -0,0 +1,165 @@
+#include <stdio.h>
+
+#include "XPLMDataAccess.h"
+
+#include "profiler.h"
+
+// Seconds of flight loop time per published window
+const float PROFILE_WINDOW_SECONDS = 1.0f;
+
+// Log-linear histogram: values below 4 ns get their own bucket, above that
+// each power of two is split into 4 sub-buckets (<= 25% error), covering up
+// to 2^32 ns
+const int PROFILE_SUB_BUCKETS = 4;
+const int PROFILE_BUCKETS = 128;
+
+const char* PROFILE_STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "sample",
+    "rpm_label",
+    "throttle_label",
+    "slider_label",
+    "autothrottle",
+    "record",
+    "total",
+};
+
+const char* PROFILE_STAT_NAMES[] = { "min_us", "mean_us", "p99_us", "max_us" };
+const int PROFILE_STAT_COUNT = 4;
+
+struct ProfileHistogram {
+    uint32_t buckets[PROFILE_BUCKETS];
+    uint32_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+};
+
+static ProfileHistogram g_histograms[PROFILE_STAGE_COUNT];
+static float g_window_elapsed = 0.0f;
+
+// Published stats per stage: min, mean, p99, max in microseconds
+static float g_stats[PROFILE_STAGE_COUNT][PROFILE_STAT_COUNT];
+
+static XPLMDataRef g_stat_datarefs[PROFILE_STAGE_COUNT][PROFILE_STAT_COUNT];
+
+static int HighestBit(uint64_t value) {
+    int bit = 0;
+    if (value >> 32) { value >>= 32; bit += 32; }
+    if (value >> 16) { value >>= 16; bit += 16; }
+    if (value >> 8) { value >>= 8; bit += 8; }
+    if (value >> 4) { value >>= 4; bit += 4; }
+    if (value >> 2) { value >>= 2; bit += 2; }
+    if (value >> 1) { bit += 1; }
+    return bit;
+}
+
+static int BucketIndex(uint64_t nanoseconds) {
+    if (nanoseconds < PROFILE_SUB_BUCKETS) {
+        return (int)nanoseconds;
+    }
+    int msb = HighestBit(nanoseconds);
+    int sub = (int)((nanoseconds >> (msb - 2)) & (PROFILE_SUB_BUCKETS - 1));
+    int index = (msb - 1) * PROFILE_SUB_BUCKETS + sub;
+    return (index < PROFILE_BUCKETS) ? index : PROFILE_BUCKETS - 1;
+}
+
+// Upper edge of a bucket in nanoseconds
+static uint64_t BucketUpperBound(int index) {
+    if (index < PROFILE_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+    int msb = index / PROFILE_SUB_BUCKETS + 1;
+    int sub = index % PROFILE_SUB_BUCKETS;
+    return ((uint64_t)(PROFILE_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+static void PublishWindow(ProfileStage stage) {
+    ProfileHistogram& histogram = g_histograms[stage];
+
+    uint32_t p99_rank = histogram.count - histogram.count / 100;
+    uint32_t seen = 0;
+    uint64_t p99 = histogram.max;
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= p99_rank) {
+            p99 = BucketUpperBound(i);
+            break;
+        }
+    }
+    if (p99 > histogram.max) {
+        p99 = histogram.max;
+    }
+
+    float* stats = g_stats[stage];
+    stats[0] = histogram.min / 1000.0f;
+    stats[1] = (float)((double)histogram.sum / histogram.count / 1000.0);
+    stats[2] = p99 / 1000.0f;
+    stats[3] = histogram.max / 1000.0f;
+
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        histogram.buckets[i] = 0;
+    }
+    histogram.count = 0;
+    histogram.sum = 0;
+    histogram.min = 0;
+    histogram.max = 0;
+}
+
+void ProfilerRecord(ProfileStage stage, uint64_t nanoseconds) {
+    ProfileHistogram& histogram = g_histograms[stage];
+    histogram.buckets[BucketIndex(nanoseconds)]++;
+    histogram.sum += nanoseconds;
+    if (histogram.count == 0 || nanoseconds < histogram.min) {
+        histogram.min = nanoseconds;
+    }
+    if (nanoseconds > histogram.max) {
+        histogram.max = nanoseconds;
+    }
+    histogram.count++;
+}
+
+void ProfilerAdvance(float seconds) {
+    g_window_elapsed += seconds;
+    if (g_window_elapsed < PROFILE_WINDOW_SECONDS) {
+        return;
+    }
+    g_window_elapsed = 0.0f;
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        if (g_histograms[stage].count > 0) {
+            PublishWindow((ProfileStage)stage);
+        }
+    }
+}
+
+static float ReadStat(void* refcon) {
+    return *static_cast<float*>(refcon);
+}
+
+void ProfilerRegisterDatarefs(void) {
+    char name[128];
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        for (int stat = 0; stat < PROFILE_STAT_COUNT; stat++) {
+            snprintf(name, sizeof(name), "xpautothrottle/profile/%s/%s", PROFILE_STAGE_NAMES[stage], PROFILE_STAT_NAMES[stat]);
+            g_stat_datarefs[stage][stat] = XPLMRegisterDataAccessor(
+                name, xplmType_Float, 0,
+                nullptr, nullptr,
+                ReadStat, nullptr,
+                nullptr, nullptr,
+                nullptr, nullptr,
+                nullptr, nullptr,
+                nullptr, nullptr,
+                &g_stats[stage][stat], nullptr);
+        }
+    }
+}
+
+void ProfilerUnregisterDatarefs(void) {
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        for (int stat = 0; stat < PROFILE_STAT_COUNT; stat++) {
+            if (g_stat_datarefs[stage][stat]) {
+                XPLMUnregisterDataAccessor(g_stat_datarefs[stage][stat]);
+                g_stat_datarefs[stage][stat] = nullptr;
+            }
+        }
+    }
+}
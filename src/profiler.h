@@ -0,0 +1,49 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <stdint.h>
+
+// Flight loop stages timed by the profiler
+enum ProfileStage {
+    PROFILE_SAMPLE = 0,         // SampleEngineState
+    PROFILE_RPM_LABEL,          // UpdateRpmLabel
+    PROFILE_THROTTLE_LABEL,     // UpdateThrottleLabel
+    PROFILE_SLIDER_LABEL,       // UpdateSliderValueLabel
+    PROFILE_AUTOTHROTTLE,       // UpdateAutothrottle
+    PROFILE_RECORD,             // RecordSample
+    PROFILE_TOTAL,              // Whole control loop callback (FlightLoopCallback)
+    PROFILE_STAGE_COUNT
+};
+
+// Record one timing sample for a stage into its fixed-size histogram.
+// Never allocates.
+void ProfilerRecord(ProfileStage stage, uint64_t nanoseconds);
+
+// Advance the window clock by the flight loop's elapsed time. Every
+// PROFILE_WINDOW_SECONDS the min/mean/p99/max of each stage that recorded
+// in the window are published and its histogram restarts, so stages run at
+// a low rate report as promptly as those run every frame.
+void ProfilerAdvance(float seconds);
+
+// Publish the stats as read-only datarefs under xpautothrottle/profile/
+void ProfilerRegisterDatarefs(void);
+void ProfilerUnregisterDatarefs(void);
+
+// Times the enclosing scope and records it against a stage
+class ProfileScope {
+public:
+    explicit ProfileScope(ProfileStage stage)
+        : m_stage(stage), m_start(std::chrono::steady_clock::now()) {}
+
+    ~ProfileScope() {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        ProfilerRecord(m_stage, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    ProfileStage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#endif // PROFILER_H
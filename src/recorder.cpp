@@ -0,0 +1,204 @@
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+#include "XPLMDataAccess.h"
+
+#include "recorder.h"
+#include "spsc_ring.h"
+
+// Ring capacity in samples: about a minute of ticks at 60 fps, far longer
+// than the writer ever lags
+const uint32_t RECORDER_CAPACITY = 4096;
+
+// How long the writer sleeps once the ring is drained
+const std::chrono::milliseconds RECORDER_DRAIN_INTERVAL(100);
+
+// Size past which the log moves on to a new numbered file: about 7 hours
+// of a single at 60 fps. A file can pass it by one drain of the ring.
+const long RECORDER_MAX_FILE_BYTES = 64L * 1024 * 1024;
+
+// Numbered files per session, from _001
+const int RECORDER_MAX_PARTS = 999;
+
+static SpscRing<FlightLogSample, RECORDER_CAPACITY> g_ring;
+
+// Owned by the writer thread while it runs
+static FILE* g_file = nullptr;
+static char g_path[1024];
+static int g_part = 0;
+static std::thread g_writer;
+static std::atomic<bool> g_running(false);
+
+// Updated by the writer thread (written) and the sim thread (dropped), read
+// by the dataref accessors
+static std::atomic<uint64_t> g_samples_written(0);
+static std::atomic<uint64_t> g_samples_dropped(0);
+
+static XPLMDataRef g_written_dataref = nullptr;
+static XPLMDataRef g_dropped_dataref = nullptr;
+
+// Path of a numbered file: the session's path with _NNN before the
+// extension, so the parts sort after the first file and in order
+static void PartPath(char* path, size_t size, int part) {
+    const char* extension = strrchr(g_path, '.');
+    const char* separator = strrchr(g_path, '/');
+    const char* backslash = strrchr(g_path, '\\');
+    separator = (backslash > separator) ? backslash : separator;
+    if (!extension || extension < separator) {
+        extension = g_path + strlen(g_path);
+    }
+    snprintf(path, size, "%.*s_%03d%s", (int)(extension - g_path), g_path, part, extension);
+}
+
+// Create a log file with its header. Returns nullptr on failure.
+static FILE* OpenLog(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file && !FlightLogWriteHeader(file)) {
+        fclose(file);
+        file = nullptr;
+    }
+    return file;
+}
+
+// Move on to the next numbered file. Returns false if there is none.
+static bool Rotate(void) {
+    fclose(g_file);
+    g_file = nullptr;
+    if (g_part >= RECORDER_MAX_PARTS) {
+        return false;
+    }
+    char path[1100];
+    PartPath(path, sizeof(path), ++g_part);
+    g_file = OpenLog(path);
+    return g_file != nullptr;
+}
+
+// Write everything currently queued, counting what is written, first
+// moving on to the next file if this one is full. Returns false on a write
+// error; the rest of the queue is then dropped.
+static bool DrainRing(void) {
+    FlightLogSample sample;
+    uint32_t written = 0;
+    uint32_t dropped = 0;
+    bool ok = g_file != nullptr && (ftell(g_file) < RECORDER_MAX_FILE_BYTES || Rotate());
+    while (g_ring.Pop(&sample)) {
+        if (ok && FlightLogWriteSample(g_file, sample)) {
+            written++;
+        } else {
+            ok = false;
+            dropped++;
+        }
+    }
+    g_samples_written.fetch_add(written, std::memory_order_relaxed);
+    g_samples_dropped.fetch_add(dropped, std::memory_order_relaxed);
+    return ok && fflush(g_file) == 0;
+}
+
+// Stop recording after a failed write: close what was written so far and
+// let RecorderPush drop the samples from here on
+static void StopWriting(void) {
+    if (g_file) {
+        fclose(g_file);
+        g_file = nullptr;
+    }
+    g_running.store(false, std::memory_order_release);
+}
+
+static void WriterThread(void) {
+    while (g_running.load(std::memory_order_acquire)) {
+        if (!DrainRing()) {
+            StopWriting();
+            return;
+        }
+        std::this_thread::sleep_for(RECORDER_DRAIN_INTERVAL);
+    }
+}
+
+bool RecorderStart(const char* path) {
+    if (g_running.load(std::memory_order_acquire)) {
+        return true;
+    }
+    // A writer that stopped on a failed write has exited but not been joined
+    if (g_writer.joinable()) {
+        g_writer.join();
+    }
+
+    g_file = OpenLog(path);
+    if (!g_file) {
+        return false;
+    }
+    snprintf(g_path, sizeof(g_path), "%s", path);
+    g_part = 0;
+
+    g_ring.Clear();
+    g_samples_written.store(0, std::memory_order_relaxed);
+    g_samples_dropped.store(0, std::memory_order_relaxed);
+    g_running.store(true, std::memory_order_release);
+    g_writer = std::thread(WriterThread);
+    return true;
+}
+
+void RecorderStop(void) {
+    if (!g_writer.joinable()) {
+        return;
+    }
+
+    g_running.store(false, std::memory_order_release);
+    g_writer.join();
+
+    // The producer is the caller's thread, so nothing is pushed past here
+    if (g_file) {
+        DrainRing();
+        fclose(g_file);
+        g_file = nullptr;
+    }
+}
+
+void RecorderPush(const FlightLogSample& sample) {
+    if (!g_running.load(std::memory_order_relaxed) || !g_ring.Push(sample)) {
+        g_samples_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t RecorderSamplesWritten(void) {
+    return g_samples_written.load(std::memory_order_relaxed);
+}
+
+uint64_t RecorderSamplesDropped(void) {
+    return g_samples_dropped.load(std::memory_order_relaxed);
+}
+
+static int ReadCounter(void* refcon) {
+    return (int)static_cast<std::atomic<uint64_t>*>(refcon)->load(std::memory_order_relaxed);
+}
+
+static XPLMDataRef RegisterCounter(const char* name, std::atomic<uint64_t>* counter) {
+    return XPLMRegisterDataAccessor(
+        name, xplmType_Int, 0,
+        ReadCounter, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        nullptr, nullptr,
+        counter, nullptr);
+}
+
+void RecorderRegisterDatarefs(void) {
+    g_written_dataref = RegisterCounter("xpautothrottle/recorder/samples_written", &g_samples_written);
+    g_dropped_dataref = RegisterCounter("xpautothrottle/recorder/samples_dropped", &g_samples_dropped);
+}
+
+void RecorderUnregisterDatarefs(void) {
+    if (g_written_dataref) {
+        XPLMUnregisterDataAccessor(g_written_dataref);
+        g_written_dataref = nullptr;
+    }
+    if (g_dropped_dataref) {
+        XPLMUnregisterDataAccessor(g_dropped_dataref);
+        g_dropped_dataref = nullptr;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+
+#include "flight_log.h"
+
+// Flight data recorder. The flight loop pushes one sample per tick into a
+// preallocated lock-free ring; a background thread drains it into a flight
+// log file. The sim thread never blocks on disk I/O or allocates, so the
+// recorder can stay on permanently. Once a file passes 64 MB the log
+// carries on in a new file named after it with _001, _002, ... before the
+// extension, each with its own header. A failed write closes the file and
+// stops the recording; samples pushed after that are counted as dropped.
+
+// Open the log file and start the writer thread. Returns false (and
+// records nothing) if the file cannot be created. Restarts a recording
+// stopped by a failed write.
+bool RecorderStart(const char* path);
+
+// Stop the writer thread, flush the remaining samples and close the file
+void RecorderStop(void);
+
+// Queue a sample. Called from the flight loop only. Drops the sample and
+// counts it if the recorder is stopped or the ring is full.
+void RecorderPush(const FlightLogSample& sample);
+
+// Samples written to disk and samples dropped since RecorderStart()
+uint64_t RecorderSamplesWritten(void);
+uint64_t RecorderSamplesDropped(void);
+
+// Publish the counters as read-only datarefs under xpautothrottle/recorder/
+void RecorderRegisterDatarefs(void);
+void RecorderUnregisterDatarefs(void);
+
+#endif // RECORDER_H
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "XPWidgets.h"
+
+#include "widget_binding.h"
+
+void BindLabel(LabelBinding* binding, XPWidgetID widget, const char* prefix, int decimals, const char* suffix) {
+    binding->widget = widget;
+    binding->prefix = prefix;
+    binding->suffix = suffix;
+    binding->decimals = decimals;
+    binding->shown_value = 0;
+    binding->shown_valid = false;
+    binding->dirty = true;
+}
+
+void UnbindLabel(LabelBinding* binding) {
+    binding->widget = nullptr;
+    binding->dirty = true;
+}
+
+int FormatFixed(char* out, int scaled_value, int decimals) {
+    char digits[16];
+    int count = 0;
+    bool negative = scaled_value < 0;
+    unsigned int magnitude = negative ? 0u - (unsigned int)scaled_value : (unsigned int)scaled_value;
+
+    // Emit digits in reverse, padding so there is at least one before the point
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0 || count <= decimals);
+
+    int length = 0;
+    if (negative) {
+        out[length++] = '-';
+    }
+    while (count > 0) {
+        if (count == decimals) {
+            out[length++] = '.';
+        }
+        out[length++] = digits[--count];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+void UpdateLabel(LabelBinding* binding, bool valid, int scaled_value) {
+    if (!binding->widget) {
+        return;
+    }
+    if (!binding->dirty && valid == binding->shown_valid && (!valid || scaled_value == binding->shown_value)) {
+        return;
+    }
+
+    char text[64];
+    size_t prefix_length = strlen(binding->prefix);
+    memcpy(text, binding->prefix, prefix_length);
+    char* cursor = text + prefix_length;
+    if (valid) {
+        cursor += FormatFixed(cursor, scaled_value, binding->decimals);
+        strcpy(cursor, binding->suffix);
+    } else {
+        strcpy(cursor, "INVALID");
+    }
+
+    XPSetWidgetDescriptor(binding->widget, text);
+    binding->shown_value = scaled_value;
+    binding->shown_valid = valid;
+    binding->dirty = false;
+}
@@ -0,0 +1,32 @@
+#ifndef WIDGET_BINDING_H
+#define WIDGET_BINDING_H
+
+#include "XPWidgetDefs.h"
+
+// Caption widget bound to a fixed-point value. The text is only formatted
+// and the descriptor only set when the displayed value changes, so a
+// steady value costs one integer compare per update.
+struct LabelBinding {
+    XPWidgetID widget;
+    const char* prefix;     // Text before the value, e.g. "RPM: "
+    const char* suffix;     // Text after the value, e.g. "%"
+    int decimals;           // Digits after the decimal point
+    int shown_value;        // Value currently displayed (scaled by 10^decimals)
+    bool shown_valid;       // Whether a value (rather than INVALID) is displayed
+    bool dirty;             // Widget text must be rewritten on the next update
+};
+
+// Attach a binding to a caption widget and mark it for an initial update
+void BindLabel(LabelBinding* binding, XPWidgetID widget, const char* prefix, int decimals, const char* suffix);
+
+// Detach the binding, e.g. when its widget is destroyed
+void UnbindLabel(LabelBinding* binding);
+
+// Show a value, already scaled by 10^decimals, or INVALID if !valid
+void UpdateLabel(LabelBinding* binding, bool valid, int scaled_value);
+
+// Format a scaled fixed-point value, e.g. (1234, 1) -> "123.4". Returns the
+// number of characters written, not counting the terminator.
+int FormatFixed(char* out, int scaled_value, int decimals);
+
+#endif // WIDGET_BINDING_H
@@ -0,0 +1,201 @@
+// Closed-loop controller benchmark: runs the autothrottle control law
+// against the engine model over a library of scripted scenarios and reports
+// settling time, overshoot, steady-state error, time in tolerance and
+// throttle travel. The flight loop's scheduling is mirrored: every frame
+// while out of tolerance, every LOOP_INTERVAL_IDLE seconds otherwise.
+// With --require-settle the exit status is 1 if any scenario never settles,
+// ends with a steady-state error outside the tolerance band, fails to
+// respect a pilot override, or overshoots the target (after a step or the
+// pilot's hand-back) by more than --max-overshoot RPM or takes longer than
+// --max-settle seconds to settle. With --min-schedule-ratio each scenario
+// is flown again without the profile's gain schedule, and the kp it ends
+// on must be at least that many times the unscheduled one, with or without
+// adaptation.
+//
+// Usage:
+//     xpat_benchmark [--fps F] [--scenario NAME] [--json PATH]
+//                    [--profile PATH] [--kp K] [--ki K] [--kd K] [--adaptive]
+//                    [--inertia I] [--throttle-lag S] [--require-settle]
+//                    [--max-overshoot R] [--max-settle S] [--min-schedule-ratio R]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <vector>
+
+#include "controller.h"
+#include "engine_model.h"
+#include "gain_profile.h"
+#include "scenarios.h"
+
+struct BenchmarkOptions {
+    float fps = 60.0f;
+    const char* scenario = nullptr;
+    const char* json_path = nullptr;
+    GainProfile profile = DefaultGainProfile();
+    bool adaptive = false;
+    bool require_settle = false;
+    float max_overshoot = -1.0f;    // RPM; < 0 leaves overshoot unbounded
+    float max_settle = -1.0f;       // Seconds; < 0 leaves settling time unbounded
+    float min_schedule_ratio = -1.0f;   // < 0 skips the unscheduled comparison
+    EngineModelParams engine = DefaultEngineModelParams();
+};
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--fps F] [--scenario NAME] [--json PATH] [--profile PATH] [--kp K] [--ki K] [--kd K]\n"
+            "       [--adaptive] [--inertia I] [--throttle-lag S] [--require-settle] [--max-overshoot R]\n"
+            "       [--max-settle S] [--min-schedule-ratio R]\n",
+            argv0);
+}
+
+static bool ParseOptions(int argc, char** argv, BenchmarkOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--adaptive")) {
+            options->adaptive = true;
+        } else if (!strcmp(arg, "--require-settle")) {
+            options->require_settle = true;
+        } else if (!value) {
+            return false;
+        } else if (!strcmp(arg, "--fps")) {
+            options->fps = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--scenario")) {
+            options->scenario = value; i++;
+        } else if (!strcmp(arg, "--json")) {
+            options->json_path = value; i++;
+        } else if (!strcmp(arg, "--profile")) {
+            if (!LoadGainProfile(value, &options->profile)) {
+                fprintf(stderr, "Cannot load gain profile %s\n", value);
+                return false;
+            }
+            i++;
+        } else if (!strcmp(arg, "--kp")) {
+            options->profile.gains.kp = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--ki")) {
+            options->profile.gains.ki = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--kd")) {
+            options->profile.gains.kd = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--inertia")) {
+            options->engine.inertia = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--throttle-lag")) {
+            options->engine.throttle_lag = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--max-overshoot")) {
+            options->max_overshoot = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--max-settle")) {
+            options->max_settle = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--min-schedule-ratio")) {
+            options->min_schedule_ratio = (float)atof(value); i++;
+        } else {
+            return false;
+        }
+    }
+    return options->fps > 0.0f && options->engine.inertia > 0.0f;
+}
+
+// A scenario passes if it settles and holds the target within the band,
+// leaves the levers to the pilot while they hold them, and stays within
+// the overshoot and settling time bounds
+static bool ScenarioPassed(const BenchmarkOptions& options, const ScenarioResult& result) {
+    if (!result.override_respected) {
+        return false;
+    }
+    if (options.max_overshoot >= 0.0f && result.overshoot_rpm > options.max_overshoot) {
+        return false;
+    }
+    if (options.max_settle >= 0.0f && result.settling_time > options.max_settle) {
+        return false;
+    }
+    return result.settling_time >= 0.0f && result.steady_state_error <= RPM_TOLERANCE;
+}
+
+static void WriteJson(FILE* out, const BenchmarkOptions& options, const Scenario* const scenarios[], const ScenarioResult results[], int count) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"fps\": %g,\n", options.fps);
+    fprintf(out, "  \"rpm_tolerance\": %g,\n", RPM_TOLERANCE);
+    fprintf(out, "  \"adaptive\": %s,\n", options.adaptive ? "true" : "false");
+    fprintf(out, "  \"gains\": { \"kp\": %g, \"ki\": %g, \"kd\": %g, \"kt\": %g, \"derivative_tau\": %g, \"rate_limit\": %g },\n",
+            options.profile.gains.kp, options.profile.gains.ki, options.profile.gains.kd, options.profile.gains.kt,
+            options.profile.gains.derivative_tau, options.profile.gains.rate_limit);
+    fprintf(out, "  \"scenarios\": [\n");
+    for (int i = 0; i < count; i++) {
+        const ScenarioResult& r = results[i];
+        fprintf(out, "    { \"name\": \"%s\", ", scenarios[i]->name);
+        if (r.settling_time >= 0.0f) {
+            fprintf(out, "\"settling_time_s\": %.3f, ", r.settling_time);
+        } else {
+            fprintf(out, "\"settling_time_s\": null, ");
+        }
+        fprintf(out, "\"overshoot_rpm\": %.2f, \"peak_error_rpm\": %.2f, \"steady_state_error_rpm\": %.3f, "
+                     "\"time_in_tolerance\": %.4f, \"throttle_travel\": %.4f, \"controller_calls\": %ld, "
+                     "\"override_respected\": %s, \"final_kp\": %g, \"final_ki\": %g }%s\n",
+                r.overshoot_rpm, r.peak_error_rpm, r.steady_state_error,
+                r.time_in_tolerance, r.throttle_travel, r.controller_calls,
+                r.override_respected ? "true" : "false", r.final_kp, r.final_ki,
+                (i + 1 < count) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<const Scenario*> selected;
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        if (!options.scenario || !strcmp(options.scenario, SCENARIOS[i].name)) {
+            selected.push_back(&SCENARIOS[i]);
+        }
+    }
+    const int count = (int)selected.size();
+    std::vector<ScenarioResult> results(count);
+    if (count == 0) {
+        fprintf(stderr, "Unknown scenario %s\n", options.scenario);
+        return 2;
+    }
+
+    printf("%-18s %9s %10s %10s %9s %8s %8s\n",
+           "scenario", "settle_s", "overshoot", "peak_err", "ss_err", "in_tol", "travel");
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        results[i] = RunScenario(*selected[i], options.profile, options.engine, options.fps, options.adaptive);
+        const ScenarioResult& r = results[i];
+        printf("%-18s %9.2f %10.1f %10.1f %9.2f %7.1f%% %8.3f\n",
+               selected[i]->name, r.settling_time, r.overshoot_rpm, r.peak_error_rpm,
+               r.steady_state_error, r.time_in_tolerance * 100.0f, r.throttle_travel);
+        if (!ScenarioPassed(options, r)) {
+            failed++;
+        } else if (options.min_schedule_ratio >= 0.0f) {
+            GainProfile unscheduled = options.profile;
+            unscheduled.schedule.altitude_count = 0;
+            ScenarioResult u = RunScenario(*selected[i], unscheduled, options.engine, options.fps, options.adaptive);
+            float ratio = (u.final_kp > 0.0f) ? r.final_kp / u.final_kp : 0.0f;
+            printf("%-18s kp %.6f, %.2f times %.6f unscheduled\n", "", r.final_kp, ratio, u.final_kp);
+            if (ratio < options.min_schedule_ratio) {
+                failed++;
+            }
+        }
+    }
+
+    if (options.json_path) {
+        FILE* out = fopen(options.json_path, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", options.json_path);
+            return 1;
+        }
+        WriteJson(out, options, selected.data(), results.data(), count);
+        fclose(out);
+    }
+
+    if (options.require_settle && failed > 0) {
+        fprintf(stderr, "%d of %d scenarios failed\n", failed, count);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <cmath>
+
+#include "engine_model.h"
+
+EngineModelParams DefaultEngineModelParams(void) {
+    EngineModelParams params;
+    params.rated_rpm = 2700.0f;
+    params.idle_torque = 0.12f;
+    params.torque_droop = 0.1f;
+    params.prop_load = 1.405f;
+    params.advance_per_kt = 0.00204f;
+    params.inertia = 1.8f;
+    params.throttle_lag = 0.15f;
+    params.thrust_accel = 6.0f;
+    params.drag_accel = 2.93f;
+    params.governor_min_rpm = 1800.0f;
+    params.governor_max_rpm = 2700.0f;
+    params.governor_rate = 3.0f;
+    params.pitch_min = 0.3f;
+    params.pitch_max = 2.5f;
+    params.manifold_idle = 0.3f;
+    params.manifold_rpm_drop = 0.35f;
+    return params;
+}
+
+// ISA sea level pressure (inHg)
+const float SEA_LEVEL_INHG = 29.92f;
+
+// Manifold pressure at normalised speed n: throttle opening less the
+// pumping loss of turning faster
+static float ManifoldInhg(const EngineModelParams& params, float throttle, float n, float density_ratio) {
+    // Troposphere: pressure ratio = sigma ^ (5.2559 / 4.2559)
+    float ambient = SEA_LEVEL_INHG * powf(fmaxf(density_ratio, 0.0f), 1.235f);
+    float open = params.manifold_idle + (1.0f - params.manifold_idle) * throttle;
+    return ambient * open * (1.0f - params.manifold_rpm_drop * (n - 0.9f));
+}
+
+// Engine and prop torque of a constant-speed engine at normalised speed n
+static float ConstantSpeedEngineTorque(const EngineModelParams& params, float manifold_inhg, float n) {
+    return manifold_inhg / SEA_LEVEL_INHG * (1.0f + params.torque_droop - params.torque_droop * n);
+}
+
+static float PropTorque(const EngineModelParams& params, float pitch, float n, float true_airspeed_kt, float density_ratio) {
+    return params.prop_load * pitch * density_ratio * n * (n - params.advance_per_kt * true_airspeed_kt);
+}
+
+// Normalised speed the governor holds for a prop lever position
+static float GovernedSpeed(const EngineModelParams& params, float prop_lever) {
+    float lever = fminf(fmaxf(prop_lever, 0.0f), 1.0f);
+    return (params.governor_min_rpm + lever * (params.governor_max_rpm - params.governor_min_rpm)) / params.rated_rpm;
+}
+
+// Net torque on the shaft at normalised speed n
+static float NetTorque(const EngineModelParams& params, float throttle, float n, float true_airspeed_kt, float density_ratio) {
+    float engine = density_ratio * (params.idle_torque + (1.0f - params.idle_torque) * throttle) * (1.0f + params.torque_droop - params.torque_droop * n);
+    float prop = params.prop_load * density_ratio * n * (n - params.advance_per_kt * true_airspeed_kt);
+    return engine - prop;
+}
+
+float EngineModelSteadyRpm(const EngineModel& model, float throttle) {
+    // Net torque falls monotonically with n over the operating range, so
+    // bisect for the balance point
+    float lo = 0.0f;
+    float hi = 2.0f;
+    for (int i = 0; i < 40; i++) {
+        float mid = 0.5f * (lo + hi);
+        if (NetTorque(model.params, throttle, mid, model.true_airspeed_kt, model.density_ratio) > 0.0f) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0.5f * (lo + hi) * model.params.rated_rpm;
+}
+
+void EngineModelInit(EngineModel* model, const EngineModelParams& params, int num_engines, float throttle, float true_airspeed_kt, float density_ratio) {
+    model->params = params;
+    model->num_engines = num_engines;
+    model->true_airspeed_kt = true_airspeed_kt;
+    model->density_ratio = density_ratio;
+    model->airframe = false;
+    model->constant_speed = false;
+    for (int i = 0; i < MAX_ENGINES; i++) {
+        model->throttle[i] = throttle;
+        model->effective_throttle[i] = throttle;
+        model->rpm[i] = EngineModelSteadyRpm(*model, throttle);
+        model->prop_lever[i] = 0.0f;
+        model->pitch[i] = 1.0f;
+        model->manifold_inhg[i] = ManifoldInhg(params, throttle, model->rpm[i] / params.rated_rpm, density_ratio);
+    }
+}
+
+void EngineModelSetConstantSpeed(EngineModel* model, float prop_lever) {
+    const EngineModelParams& params = model->params;
+    model->constant_speed = true;
+    for (int i = 0; i < MAX_ENGINES; i++) {
+        float n = GovernedSpeed(params, prop_lever);
+        float manifold = ManifoldInhg(params, model->effective_throttle[i], n, model->density_ratio);
+        float load = PropTorque(params, 1.0f, n, model->true_airspeed_kt, model->density_ratio);
+        model->prop_lever[i] = prop_lever;
+        model->rpm[i] = n * params.rated_rpm;
+        model->manifold_inhg[i] = manifold;
+        model->pitch[i] = (load > 0.0f) ? fminf(fmaxf(ConstantSpeedEngineTorque(params, manifold, n) / load, params.pitch_min), params.pitch_max)
+                                        : params.pitch_min;
+    }
+}
+
+void EngineModelStep(EngineModel* model, float dt) {
+    if (dt <= 0.0f) {
+        return;
+    }
+
+    const EngineModelParams& params = model->params;
+    const float lag_alpha = dt / (params.throttle_lag + dt);
+    float thrust = 0.0f;
+
+    for (int i = 0; i < model->num_engines; i++) {
+        float throttle = fminf(fmaxf(model->throttle[i], 0.0f), 1.0f);
+        model->effective_throttle[i] += lag_alpha * (throttle - model->effective_throttle[i]);
+
+        float n = model->rpm[i] / params.rated_rpm;
+        model->manifold_inhg[i] = ManifoldInhg(params, model->effective_throttle[i], n, model->density_ratio);
+        float torque;
+        if (model->constant_speed) {
+            // The governor coarsens the blades while overspeeding
+            float overspeed = n - GovernedSpeed(params, model->prop_lever[i]);
+            model->pitch[i] = fminf(fmaxf(model->pitch[i] + params.governor_rate * overspeed * dt, params.pitch_min), params.pitch_max);
+            torque = ConstantSpeedEngineTorque(params, model->manifold_inhg[i], n) -
+                     PropTorque(params, model->pitch[i], n, model->true_airspeed_kt, model->density_ratio);
+            thrust += model->pitch[i] * n * (n - params.advance_per_kt * model->true_airspeed_kt);
+        } else {
+            torque = NetTorque(params, model->effective_throttle[i], n, model->true_airspeed_kt, model->density_ratio);
+            thrust += n * (n - params.advance_per_kt * model->true_airspeed_kt);
+        }
+        n += torque / params.inertia * dt;
+        model->rpm[i] = fmaxf(n, 0.0f) * params.rated_rpm;
+    }
+
+    // Level flight: thrust shared between the engines, drag rising with
+    // the square of airspeed
+    if (model->airframe && model->num_engines > 0) {
+        float v = model->true_airspeed_kt / 100.0f;
+        float accel = model->density_ratio * (params.thrust_accel * thrust / model->num_engines - params.drag_accel * v * v);
+        model->true_airspeed_kt = fmaxf(model->true_airspeed_kt + accel * dt, 0.0f);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef ENGINE_MODEL_H
+#define ENGINE_MODEL_H
+
+#include "plugin.h"
+
+// Simple fixed-pitch propeller engine model used to exercise the plugin
+// outside X-Plane. Engine torque rises with throttle and air density, prop
+// load rises with RPM squared and falls with airspeed, and the difference
+// accelerates the rotating inertia. Speeds are normalised to rated RPM.
+// Optionally the airframe is flown too: prop thrust less drag accelerates
+// the aircraft in level flight, for the speed hold modes. Optionally the
+// prop is constant-speed: a governor moves the blade pitch, and so the prop
+// load, to hold the RPM the prop lever selects, the throttle sets manifold
+// pressure, and engine torque follows manifold pressure.
+struct EngineModelParams {
+    float rated_rpm;        // RPM at n = 1.0
+    float idle_torque;      // Engine torque at closed throttle (fraction of max)
+    float torque_droop;     // Torque lost per unit of normalised RPM
+    float prop_load;        // Prop torque coefficient
+    float advance_per_kt;   // Prop unloading per knot of true airspeed
+    float inertia;          // Rotating inertia (normalised torque-seconds)
+    float throttle_lag;     // Throttle to manifold pressure time constant (s)
+    float thrust_accel;     // Airspeed gained per second per unit prop thrust coefficient (kt/s)
+    float drag_accel;       // Airspeed lost per second to drag at 100 KIAS (kt/s)
+    float governor_min_rpm; // Governed RPM with the prop lever at 0
+    float governor_max_rpm; // ... and at 1
+    float governor_rate;    // Blade pitch change per second per unit of normalised overspeed
+    float pitch_min;        // Blade pitch limits (multiples of the fixed-pitch prop load)
+    float pitch_max;
+    float manifold_idle;    // Manifold pressure at closed throttle (fraction of ambient)
+    float manifold_rpm_drop; // Manifold pressure lost per unit of normalised RPM (fraction)
+};
+
+struct EngineModel {
+    EngineModelParams params;
+    int num_engines;
+    float rpm[MAX_ENGINES];             // Engine speed (RPM)
+    float throttle[MAX_ENGINES];        // Throttle lever position (0.0-1.0)
+    float effective_throttle[MAX_ENGINES];
+    float true_airspeed_kt;             // Airspeed driving prop unloading
+    float density_ratio;                // Air density relative to sea level
+    bool airframe;                      // Fly the airspeed from thrust and drag
+    bool constant_speed;                // Governed prop; see EngineModelSetConstantSpeed
+    float prop_lever[MAX_ENGINES];      // Prop lever position (0.0-1.0)
+    float pitch[MAX_ENGINES];           // Blade pitch (1.0 is the fixed-pitch prop)
+    float manifold_inhg[MAX_ENGINES];   // Manifold pressure (inHg)
+};
+
+// Parameters approximating a C172-class engine and prop: about 800 RPM at
+// idle, 2300 RPM static at full throttle, 2400 RPM at 80% in cruise, and
+// with the airframe flown, about 110 KTAS level at 2400 RPM
+EngineModelParams DefaultEngineModelParams(void);
+
+// Reset the model to steady state at the given throttle, airspeed and
+// density, with the airspeed held fixed
+void EngineModelInit(EngineModel* model, const EngineModelParams& params, int num_engines, float throttle, float true_airspeed_kt, float density_ratio);
+
+// Switch to a constant-speed prop, steady at the current throttle with the
+// lever at prop_lever
+void EngineModelSetConstantSpeed(EngineModel* model, float prop_lever);
+
+// Advance the model by dt seconds
+void EngineModelStep(EngineModel* model, float dt);
+
+// Steady-state RPM for a throttle setting at the model's airspeed and density
+float EngineModelSteadyRpm(const EngineModel& model, float throttle);
+
+#endif // ENGINE_MODEL_H
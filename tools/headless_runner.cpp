@@ -0,0 +1,493 @@
+// Headless runner: loads the plugin built against the local XPLM stub,
+// drives it with the engine model and steps simulated time faster than
+// real time.
+//
+// Usage:
+//     xpat_headless --plugin lin.xpl [--engines N] [--seconds S] [--fps F]
+//                   [--target RPM] [--throttle T] [--airspeed KT]
+//                   [--density RATIO] [--hide-window] [--no-engage]
+//                   [--print-interval S] [--expect-settle S] [--expect-max-step T]
+//                   [--command NAME]... [--set DATAREF=VALUE]...
+//                   [--at S DATAREF=VALUE]...
+//                   [--system-path DIR] [--aircraft ACF]
+//                   [--hold-ias KT | --hold-mach M]
+//                   [--engine-type N] [--n1 PERCENT]
+//                   [--constant-speed] [--manifold INHG] [--prop-rpm RPM]
+//                   [--throttle-axis T] [--sim-speed N]
+//                   [--late-dataref S DATAREF] [--expect-profile STAGE]
+//
+// --hold-ias and --hold-mach fly the airframe too, select the speed mode by
+// command and set its target through the dataref; --expect-settle then
+// applies to the airspeed.
+//
+// --engine-type publishes X-Plane's engine type (4 or 5 for jets, 2 or 8
+// for turboprops), from which the plugin picks the variable it holds. The
+// model's N1 is its RPM as a percentage of rated. --n1 sets the held
+// variable's target through xpautothrottle/target; --expect-settle then
+// applies to N1.
+//
+// --constant-speed publishes a constant-speed prop, from which the plugin
+// picks manifold pressure and prop RPM, and gives the model a governed
+// prop. --manifold and --prop-rpm set their targets through the datarefs;
+// --expect-settle then applies to both.
+//
+// --throttle-axis writes T to the throttle levers every frame, as a
+// hardware axis would, until the plugin overrides X-Plane's throttles.
+//
+// --sim-speed runs N physics steps per frame, as X-Plane's time compression
+// does. --seconds and --at count frame time; settle times and the printed
+// times are sim time, which also stands still while sim/time/paused is set
+// (e.g. by --at).
+//
+// --expect-max-step fails the run if the throttle ever moves by more than T
+// in one frame.
+//
+// --late-dataref hides a sim dataref from the plugin until S seconds, as
+// one published by an aircraft or plugin that loads later would be. The
+// stub then announces it with XPLM_MSG_DATAREFS_ADDED.
+//
+// --expect-profile fails the run unless the profiler has published stats
+// for STAGE (e.g. rpm_label) by the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmath>
+#include <string>
+
+#include "XPLMDataAccess.h"
+#include "XPLMDefs.h"
+#include "XPLMPlugin.h"
+#include "XPLMProcessing.h"
+#include "XPStandardWidgets.h"
+
+#include "engine_model.h"
+#include "sim_host.h"
+#include "xplm_stub.h"
+
+struct RunnerOptions {
+    const char* plugin_path = "lin.xpl";
+    int engines = 1;
+    float seconds = 30.0f;
+    float fps = 30.0f;
+    int target_rpm = 2400;
+    float initial_throttle = 0.3f;
+    float airspeed_kt = 100.0f;
+    float density_ratio = 1.0f;
+    bool hide_window = false;
+    bool engage = true;
+    float print_interval = 1.0f;
+    float expect_settle = -1.0f;
+    float expect_max_step = -1.0f;
+    const char* commands[16] = {};
+    int command_count = 0;
+    const char* assignments[16] = {};
+    int assignment_count = 0;
+    const char* timed_assignments[16] = {};     // --at, applied once simulated time reaches the time
+    float assignment_times[16] = {};
+    int timed_assignment_count = 0;
+    const char* system_path = nullptr;
+    const char* aircraft_path = nullptr;
+    float hold_ias = 0.0f;
+    float hold_mach = 0.0f;
+    int engine_type = 0;
+    float n1 = 0.0f;
+    bool constant_speed = false;
+    float manifold_inhg = 0.0f;
+    float prop_rpm = 0.0f;
+    float throttle_axis = -1.0f;
+    int sim_speed = 1;
+    const char* late_dataref = nullptr;
+    float late_dataref_time = 0.0f;
+    const char* expect_profile = nullptr;
+};
+
+const float RPM_TOLERANCE = 15.0f;
+const float SPEED_TOLERANCE_KT = 2.0f;
+const float N1_TOLERANCE = 0.75f;   // The RPM tolerance in N1 percent
+const float MANIFOLD_TOLERANCE = 0.1875f; // The RPM tolerance in inHg
+const float INITIAL_PROP_LEVER = 0.5f;
+
+static float ModelN1(const EngineModel& model, int engine) {
+    return model.rpm[engine] / model.params.rated_rpm * 100.0f;
+}
+
+// True once the plugin has taken the throttles from X-Plane, which then flies
+// ENGN_thro_use rather than the levers
+static bool ThrottlesOverridden(void) {
+    return *StubIntData(DATAREF_OVERRIDE_THROTTLES) != 0;
+}
+
+static void PublishEngineModel(const EngineModel& model) {
+    float* rpm = StubFloatData(DATAREF_ENGINE_RPM);
+    float* n1 = StubFloatData(DATAREF_ENGINE_N1);
+    float* manifold = StubFloatData(DATAREF_MANIFOLD);
+    float* prop_rpm = StubFloatData(DATAREF_PROP_RPM);
+    float* prop_lever = StubFloatData(DATAREF_PROP_LEVER);
+    float* throttle = StubFloatData(ThrottlesOverridden() ? DATAREF_THROTTLE_USED : DATAREF_THROTTLE);
+    float* throttle_used = StubFloatData(DATAREF_THROTTLE_USED);
+    for (int i = 0; i < model.num_engines; i++) {
+        rpm[i] = model.rpm[i];
+        n1[i] = ModelN1(model, i);
+        manifold[i] = model.manifold_inhg[i];
+        prop_rpm[i] = model.rpm[i];     // Direct drive
+        prop_lever[i] = model.prop_lever[i];
+        throttle[i] = model.throttle[i];
+        throttle_used[i] = model.throttle[i];
+    }
+    PublishAirData(model.true_airspeed_kt, model.density_ratio);
+}
+
+// Write NAME=VALUE to a dataref as an external panel would, using its int
+// accessor when it has one
+static bool AssignDataref(const char* assignment) {
+    const char* equals = strchr(assignment, '=');
+    std::string name(assignment, equals - assignment);
+    XPLMDataRef ref = XPLMFindDataRef(name.c_str());
+    if (!ref || !XPLMCanWriteDataRef(ref)) {
+        return false;
+    }
+    if (XPLMGetDataRefTypes(ref) & xplmType_Int) {
+        XPLMSetDatai(ref, atoi(equals + 1));
+    } else {
+        XPLMSetDataf(ref, (float)atof(equals + 1));
+    }
+    return true;
+}
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s --plugin PATH [--engines N] [--seconds S] [--fps F] [--target RPM]\n"
+            "       [--throttle T] [--airspeed KT] [--density RATIO] [--hide-window]\n"
+            "       [--no-engage] [--print-interval S] [--expect-settle S] [--expect-max-step T]\n"
+            "       [--command NAME]... [--set DATAREF=VALUE]... [--at S DATAREF=VALUE]...\n"
+            "       [--system-path DIR] [--aircraft ACF]\n"
+            "       [--hold-ias KT | --hold-mach M] [--engine-type N] [--n1 PERCENT]\n"
+            "       [--constant-speed] [--manifold INHG] [--prop-rpm RPM] [--throttle-axis T]\n"
+            "       [--sim-speed N] [--late-dataref S DATAREF] [--expect-profile STAGE]\n",
+            argv0);
+}
+
+static bool ParseOptions(int argc, char** argv, RunnerOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--hide-window")) {
+            options->hide_window = true;
+        } else if (!strcmp(arg, "--no-engage")) {
+            options->engage = false;
+        } else if (!strcmp(arg, "--constant-speed")) {
+            options->constant_speed = true;
+        } else if (!value) {
+            return false;
+        } else if (!strcmp(arg, "--plugin")) {
+            options->plugin_path = value; i++;
+        } else if (!strcmp(arg, "--engines")) {
+            options->engines = atoi(value); i++;
+        } else if (!strcmp(arg, "--seconds")) {
+            options->seconds = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--fps")) {
+            options->fps = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--target")) {
+            options->target_rpm = atoi(value); i++;
+        } else if (!strcmp(arg, "--throttle")) {
+            options->initial_throttle = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--airspeed")) {
+            options->airspeed_kt = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--sim-speed")) {
+            options->sim_speed = atoi(value); i++;
+        } else if (!strcmp(arg, "--throttle-axis")) {
+            options->throttle_axis = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--density")) {
+            options->density_ratio = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--print-interval")) {
+            options->print_interval = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--expect-settle")) {
+            options->expect_settle = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--expect-max-step")) {
+            options->expect_max_step = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--expect-profile")) {
+            options->expect_profile = value; i++;
+        } else if (!strcmp(arg, "--command")) {
+            if (options->command_count >= 16) {
+                return false;
+            }
+            options->commands[options->command_count++] = value; i++;
+        } else if (!strcmp(arg, "--system-path")) {
+            options->system_path = value; i++;
+        } else if (!strcmp(arg, "--aircraft")) {
+            options->aircraft_path = value; i++;
+        } else if (!strcmp(arg, "--hold-ias")) {
+            options->hold_ias = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--hold-mach")) {
+            options->hold_mach = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--engine-type")) {
+            options->engine_type = atoi(value); i++;
+        } else if (!strcmp(arg, "--n1")) {
+            options->n1 = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--manifold")) {
+            options->manifold_inhg = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--prop-rpm")) {
+            options->prop_rpm = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--set")) {
+            if (options->assignment_count >= 16 || !strchr(value, '=')) {
+                return false;
+            }
+            options->assignments[options->assignment_count++] = value; i++;
+        } else if (!strcmp(arg, "--late-dataref")) {
+            if (i + 2 >= argc) {
+                return false;
+            }
+            options->late_dataref_time = (float)atof(value);
+            options->late_dataref = argv[i + 2]; i += 2;
+        } else if (!strcmp(arg, "--at")) {
+            const char* assignment = (i + 2 < argc) ? argv[i + 2] : nullptr;
+            if (options->timed_assignment_count >= 16 || !assignment || !strchr(assignment, '=')) {
+                return false;
+            }
+            options->assignment_times[options->timed_assignment_count] = (float)atof(value);
+            options->timed_assignments[options->timed_assignment_count++] = assignment; i += 2;
+        } else {
+            return false;
+        }
+    }
+    if (options->engines < 1 || options->engines > MAX_ENGINES || options->fps <= 0.0f ||
+        (options->hold_ias > 0.0f && options->hold_mach > 0.0f) ||
+        (options->n1 > 0.0f && (options->hold_ias > 0.0f || options->hold_mach > 0.0f)) ||
+        ((options->manifold_inhg > 0.0f || options->prop_rpm > 0.0f) && !options->constant_speed)) {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    RunnerOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    DefineSimDatarefs(options.engines, options.engine_type, options.constant_speed ? 1 : 0);
+    if (options.system_path) {
+        StubSetSystemPath(options.system_path);
+    }
+    if (options.aircraft_path) {
+        StubSetAircraftPath(options.aircraft_path);
+    }
+
+    EngineModel model;
+    EngineModelInit(&model, DefaultEngineModelParams(), options.engines, options.initial_throttle, options.airspeed_kt, options.density_ratio);
+    const bool hold_speed = options.hold_ias > 0.0f || options.hold_mach > 0.0f;
+    model.airframe = hold_speed;
+    if (options.constant_speed) {
+        EngineModelSetConstantSpeed(&model, INITIAL_PROP_LEVER);
+    }
+    PublishEngineModel(model);
+    if (options.late_dataref) {
+        StubHideDataRef(options.late_dataref);
+    }
+
+    LoadedPlugin plugin;
+    if (!LoadPlugin(options.plugin_path, &plugin)) {
+        return 1;
+    }
+
+    char name[256] = "";
+    char signature[256] = "";
+    char description[256] = "";
+    if (!plugin.start(name, signature, description) || !plugin.enable()) {
+        fprintf(stderr, "Plugin failed to start\n");
+        return 1;
+    }
+    plugin.receive_message(XPLM_PLUGIN_XPLANE, XPLM_MSG_PLANE_LOADED, nullptr);
+    printf("Loaded %s (%s), %d engine(s)\n", name, signature, options.engines);
+
+    if (options.hide_window) {
+        StubSelectMenuItem("Hide Window");
+    }
+
+    // Select the target on the slider and engage from the window, as a pilot would
+    StubSetSlider(StubFindWidgetOfClass(xpWidgetClass_ScrollBar), options.target_rpm);
+    if (options.engage) {
+        StubPushButton(StubFindWidget("OFF"));
+    }
+
+    // Then press any requested commands, as bound hardware buttons would
+    for (int i = 0; i < options.command_count; i++) {
+        if (!StubRunCommand(options.commands[i], xplm_CommandBegin) || !StubRunCommand(options.commands[i], xplm_CommandEnd)) {
+            fprintf(stderr, "Unknown command %s\n", options.commands[i]);
+            return 1;
+        }
+    }
+    if (hold_speed) {
+        const char* command = (options.hold_ias > 0.0f) ? "xpautothrottle/mode_ias" : "xpautothrottle/mode_mach";
+        StubRunCommand(command, xplm_CommandBegin);
+        StubRunCommand(command, xplm_CommandEnd);
+        XPLMSetDataf(XPLMFindDataRef((options.hold_ias > 0.0f) ? "xpautothrottle/target_ias" : "xpautothrottle/target_mach"),
+                     (options.hold_ias > 0.0f) ? options.hold_ias : options.hold_mach);
+    }
+    if (options.n1 > 0.0f) {
+        XPLMSetDataf(XPLMFindDataRef("xpautothrottle/target"), options.n1);
+    }
+    if (options.manifold_inhg > 0.0f) {
+        XPLMSetDataf(XPLMFindDataRef("xpautothrottle/target"), options.manifold_inhg);
+    }
+    if (options.prop_rpm > 0.0f) {
+        XPLMSetDataf(XPLMFindDataRef("xpautothrottle/target_prop_rpm"), options.prop_rpm);
+    }
+    for (int i = 0; i < options.assignment_count; i++) {
+        if (!AssignDataref(options.assignments[i])) {
+            fprintf(stderr, "Cannot write %s\n", options.assignments[i]);
+            return 1;
+        }
+    }
+
+    const float dt = 1.0f / options.fps;
+    const long frames = (long)(options.seconds * options.fps);
+    float settle_time = -1.0f;
+    float max_rpm = 0.0f;
+    float max_throttle_step = 0.0f;
+    float next_print = 0.0f;
+    int next_timed_assignment = 0;
+
+    for (long frame = 0; frame < frames; frame++) {
+        // Timed writes, in the order given
+        while (next_timed_assignment < options.timed_assignment_count &&
+               StubElapsedTime() >= options.assignment_times[next_timed_assignment]) {
+            if (!AssignDataref(options.timed_assignments[next_timed_assignment])) {
+                fprintf(stderr, "Cannot write %s\n", options.timed_assignments[next_timed_assignment]);
+                return 1;
+            }
+            next_timed_assignment++;
+        }
+        if (options.late_dataref && StubElapsedTime() >= options.late_dataref_time) {
+            StubPublishDataRef(options.late_dataref);
+            options.late_dataref = nullptr;
+        }
+        StubBeginFrame(dt);
+        if (options.throttle_axis >= 0.0f) {
+            for (int i = 0; i < model.num_engines; i++) {
+                StubFloatData(DATAREF_THROTTLE)[i] = options.throttle_axis;
+            }
+        }
+        StubRunFlightLoops(xplm_FlightLoop_Phase_BeforeFlightModel);
+
+        // The flight model runs sim_speed physics steps per frame, and none
+        // while paused
+        const int physics_steps = *StubIntData(DATAREF_PAUSED) ? 0 : options.sim_speed;
+        const float* throttle = StubFloatData(ThrottlesOverridden() ? DATAREF_THROTTLE_USED : DATAREF_THROTTLE);
+        const float* prop_lever = StubFloatData(DATAREF_PROP_LEVER);
+        for (int i = 0; i < model.num_engines; i++) {
+            max_throttle_step = fmaxf(max_throttle_step, fabsf(throttle[i] - model.throttle[i]));
+            model.throttle[i] = throttle[i];
+            model.prop_lever[i] = prop_lever[i];
+        }
+        for (int step = 0; step < physics_steps; step++) {
+            EngineModelStep(&model, dt);
+        }
+        AdvanceSimTime(physics_steps * dt);
+        PublishEngineModel(model);
+
+        StubRunFlightLoops(xplm_FlightLoop_Phase_AfterFlightModel);
+
+        float now = *StubFloatData(DATAREF_SIM_TIME);
+        float ias = *StubFloatData(DATAREF_INDICATED_AIRSPEED);
+        float mach = *StubFloatData(DATAREF_MACH);
+        bool in_band = true;
+        for (int i = 0; i < model.num_engines; i++) {
+            if (options.n1 > 0.0f) {
+                in_band = in_band && fabsf(ModelN1(model, i) - options.n1) <= N1_TOLERANCE;
+            } else if (options.constant_speed) {
+                // Against the published targets, which --at may change
+                in_band = in_band && fabsf(model.manifold_inhg[i] - StubGetFloat("xpautothrottle/target")) <= MANIFOLD_TOLERANCE &&
+                          fabsf(model.rpm[i] - StubGetFloat("xpautothrottle/target_prop_rpm")) <= RPM_TOLERANCE;
+            } else {
+                in_band = in_band && (hold_speed || fabsf(model.rpm[i] - options.target_rpm) <= RPM_TOLERANCE);
+            }
+            max_rpm = fmaxf(max_rpm, model.rpm[i]);
+        }
+        if (options.hold_ias > 0.0f) {
+            in_band = fabsf(ias - options.hold_ias) <= SPEED_TOLERANCE_KT;
+        } else if (options.hold_mach > 0.0f) {
+            in_band = mach > 0.0f && fabsf(options.hold_mach - mach) * ias / mach <= SPEED_TOLERANCE_KT;
+        }
+        if (!in_band) {
+            settle_time = -1.0f;
+        } else if (settle_time < 0.0f) {
+            settle_time = now;
+        }
+
+        if (options.print_interval > 0.0f && now >= next_print) {
+            if (hold_speed) {
+                printf("t=%7.2f rpm=%7.1f throttle=%.3f ias=%6.1f mach=%.3f\n", now, model.rpm[0], model.throttle[0], ias, mach);
+            } else if (options.constant_speed) {
+                printf("t=%7.2f rpm=%7.1f mp=%5.2f throttle=%.3f prop=%.3f\n", now, model.rpm[0], model.manifold_inhg[0],
+                       model.throttle[0], model.prop_lever[0]);
+            } else if (options.n1 > 0.0f) {
+                printf("t=%7.2f rpm=%7.1f n1=%5.1f throttle=%.3f\n", now, model.rpm[0], ModelN1(model, 0), model.throttle[0]);
+            } else {
+                printf("t=%7.2f rpm=%7.1f throttle=%.3f\n", now, model.rpm[0], model.throttle[0]);
+            }
+            next_print += options.print_interval;
+        }
+    }
+
+    printf("Flight loop calls: %ld in %ld frames\n", StubFlightLoopCallCount(), frames);
+    printf("Final RPM: %.1f, peak RPM: %.1f, settled at: %.2f s\n", model.rpm[0], max_rpm, settle_time);
+    printf("Largest throttle step: %.4f in one frame\n", max_throttle_step);
+    float error = 0.0f;
+    XPLMGetDatavf(XPLMFindDataRef("xpautothrottle/error"), &error, 0, 1);
+    char error_units[16] = {};
+    XPLMGetDatab(XPLMFindDataRef("xpautothrottle/error_units"), error_units, 0, sizeof(error_units) - 1);
+    printf("Published: engaged %d, target %d RPM, error %.1f %s\n",
+           StubGetInt("xpautothrottle/engaged"), StubGetInt("xpautothrottle/target_rpm"), error, error_units);
+    if (options.throttle_axis >= 0.0f) {
+        printf("Throttle axis at %.3f, engines at %.3f; X-Plane throttles overridden %d\n", options.throttle_axis,
+               model.throttle[0], ThrottlesOverridden() ? 1 : 0);
+    }
+    if (hold_speed) {
+        printf("Final IAS: %.1f kt, Mach %.3f; published mode %d, speed error %.1f kt\n",
+               *StubFloatData(DATAREF_INDICATED_AIRSPEED), *StubFloatData(DATAREF_MACH),
+               StubGetInt("xpautothrottle/mode"), StubGetFloat("xpautothrottle/speed_error"));
+    }
+    if (options.constant_speed) {
+        printf("Final manifold pressure: %.2f inHg, prop lever %.3f; published variable %d, targets %.1f inHg, %.0f RPM\n",
+               model.manifold_inhg[0], model.prop_lever[0], StubGetInt("xpautothrottle/variable"),
+               StubGetFloat("xpautothrottle/target"), StubGetFloat("xpautothrottle/target_prop_rpm"));
+    }
+    if (options.n1 > 0.0f) {
+        printf("Final N1: %.1f%%; published variable %d, target %.1f\n", ModelN1(model, 0),
+               StubGetInt("xpautothrottle/variable"), StubGetFloat("xpautothrottle/target"));
+    }
+    printf("Plant estimate: %.0f RPM per throttle, time constant %.2f s, dead time %.2f s; kp %.5f, ki %.5f\n",
+           StubGetFloat("xpautothrottle/plant/gain"), StubGetFloat("xpautothrottle/plant/time_constant"),
+           StubGetFloat("xpautothrottle/plant/dead_time"), StubGetFloat("xpautothrottle/kp"),
+           StubGetFloat("xpautothrottle/ki"));
+    printf("Flight loop cost: mean %.2f us, p99 %.2f us, max %.2f us\n",
+           StubGetFloat("xpautothrottle/profile/total/mean_us"),
+           StubGetFloat("xpautothrottle/profile/total/p99_us"),
+           StubGetFloat("xpautothrottle/profile/total/max_us"));
+    float profile_max_us = 0.0f;
+    if (options.expect_profile) {
+        std::string name = std::string("xpautothrottle/profile/") + options.expect_profile + "/max_us";
+        profile_max_us = StubGetFloat(name.c_str());
+        printf("Profiled %s: max %.2f us\n", options.expect_profile, profile_max_us);
+    }
+
+    UnloadPlugin(&plugin);
+
+    if (options.expect_settle >= 0.0f && (settle_time < 0.0f || settle_time > options.expect_settle)) {
+        fprintf(stderr, "Did not settle within %.2f s\n", options.expect_settle);
+        return 1;
+    }
+    if (options.expect_max_step >= 0.0f && max_throttle_step > options.expect_max_step) {
+        fprintf(stderr, "Throttle stepped by more than %.4f in one frame\n", options.expect_max_step);
+        return 1;
+    }
+    if (options.expect_profile && profile_max_us <= 0.0f) {
+        fprintf(stderr, "No profiler stats published for %s\n", options.expect_profile);
+        return 1;
+    }
+    return 0;
+}
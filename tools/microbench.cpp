@@ -0,0 +1,227 @@
+// Microbenchmark of the flight loop hot path. Loads the plugin against the
+// XPLM stub and invokes its control and label loops back to back, with the
+// autothrottle engaged or not and the window shown or hidden. Reports
+// nanoseconds per frame measured from outside, split into dataref
+// sampling, label formatting, control law and recording using the plugin's
+// own profiler stages.
+//
+// Usage:
+//     xpat_microbench --plugin lin.xpl [--engines N] [--iterations N]
+//                     [--static] [--system-path DIR] [--json PATH]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "XPLMPlugin.h"
+#include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+
+#include "plugin.h"
+#include "sim_host.h"
+#include "xplm_stub.h"
+
+// Invocations per batch; matches the profiler's publishing window so every
+// batch yields one fresh set of stage stats
+const int BATCH = 1000;
+
+struct MicrobenchOptions {
+    const char* plugin_path = "lin.xpl";
+    int engines = 2;
+    long iterations = 200000;
+    bool static_values = false;     // Hold RPM and throttle constant, so labels never change
+    const char* system_path = nullptr;
+    const char* json_path = nullptr;
+};
+
+struct MicrobenchCase {
+    const char* name;
+    bool engaged;
+    bool window_visible;
+};
+
+const MicrobenchCase CASES[] = {
+    { "disengaged_hidden", false, false },
+    { "disengaged_shown", false, true },
+    { "engaged_hidden", true, false },
+    { "engaged_shown", true, true },
+};
+const int CASE_COUNT = sizeof(CASES) / sizeof(CASES[0]);
+
+// Mean cost per invocation in nanoseconds
+struct MicrobenchResult {
+    double wall;        // Measured around both loops from the host
+    double total;       // Profiled control loop callback
+    double sample;      // Dataref reads
+    double labels;      // Label formatting (three labels)
+    double control;     // Control law and throttle write
+    double record;      // Flight recorder and black box
+};
+
+static double StageMeanNs(const char* stage) {
+    char name[128];
+    snprintf(name, sizeof(name), "xpautothrottle/profile/%s/mean_us", stage);
+    return StubGetFloat(name) * 1000.0;
+}
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s --plugin PATH [--engines N] [--iterations N] [--static]\n"
+            "       [--system-path DIR] [--json PATH]\n",
+            argv0);
+}
+
+static bool ParseOptions(int argc, char** argv, MicrobenchOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--static")) {
+            options->static_values = true;
+        } else if (!value) {
+            return false;
+        } else if (!strcmp(arg, "--plugin")) {
+            options->plugin_path = value; i++;
+        } else if (!strcmp(arg, "--engines")) {
+            options->engines = atoi(value); i++;
+        } else if (!strcmp(arg, "--iterations")) {
+            options->iterations = atol(value); i++;
+        } else if (!strcmp(arg, "--system-path")) {
+            options->system_path = value; i++;
+        } else if (!strcmp(arg, "--json")) {
+            options->json_path = value; i++;
+        } else {
+            return false;
+        }
+    }
+    return options->engines >= 1 && options->engines <= MAX_ENGINES && options->iterations >= BATCH;
+}
+
+// Nudge RPM and throttle so the labels and controller see new values each
+// call, as they would in flight
+static void VaryEngines(int engines, long k) {
+    float* rpm = StubFloatData(DATAREF_ENGINE_RPM);
+    float* throttle = StubFloatData(DATAREF_THROTTLE);
+    for (int i = 0; i < engines; i++) {
+        rpm[i] = 2400.0f + (float)((k * 7 + i) % 61 - 30);
+        throttle[i] = 0.75f + 0.0005f * (float)((k + i) % 41);
+    }
+}
+
+static void SetCase(const MicrobenchCase& c) {
+    StubRunCommand(c.engaged ? "xpautothrottle/engage" : "xpautothrottle/disengage", xplm_CommandBegin);
+    StubSelectMenuItem(c.window_visible ? "Show Window" : "Hide Window");
+}
+
+static MicrobenchResult RunCase(const MicrobenchCase& c, const MicrobenchOptions& options) {
+    SetCase(c);
+
+    const float dt = 1.0f / 60.0f;
+    long k = 0;
+
+    // Warm up caches and fill one profiler window
+    for (int i = 0; i < BATCH; i++, k++) {
+        if (!options.static_values) {
+            VaryEngines(options.engines, k);
+        }
+        StubBeginFrame(dt);
+        AdvanceSimTime(dt);
+        StubForceFlightLoops(xplm_FlightLoop_Phase_BeforeFlightModel);
+        StubForceFlightLoops(xplm_FlightLoop_Phase_AfterFlightModel);
+    }
+
+    MicrobenchResult result = {};
+    const long batches = options.iterations / BATCH;
+    for (long b = 0; b < batches; b++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BATCH; i++, k++) {
+            if (!options.static_values) {
+                VaryEngines(options.engines, k);
+            }
+            StubBeginFrame(dt);
+            AdvanceSimTime(dt);
+            StubForceFlightLoops(xplm_FlightLoop_Phase_BeforeFlightModel);
+            StubForceFlightLoops(xplm_FlightLoop_Phase_AfterFlightModel);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        result.wall += std::chrono::duration<double, std::nano>(elapsed).count() / BATCH;
+        result.total += StageMeanNs("total");
+        result.sample += StageMeanNs("sample");
+        // Labels only run (and only publish fresh stats) while the window is shown
+        if (c.window_visible) {
+            result.labels += StageMeanNs("rpm_label") + StageMeanNs("throttle_label") + StageMeanNs("slider_label");
+        }
+        result.control += StageMeanNs("autothrottle");
+        result.record += StageMeanNs("record");
+    }
+
+    result.wall /= batches;
+    result.total /= batches;
+    result.sample /= batches;
+    result.labels /= batches;
+    result.control /= batches;
+    result.record /= batches;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    MicrobenchOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    DefineSimDatarefs(options.engines);
+    if (options.system_path) {
+        StubSetSystemPath(options.system_path);
+    }
+    VaryEngines(options.engines, 0);
+
+    LoadedPlugin plugin;
+    if (!LoadPlugin(options.plugin_path, &plugin)) {
+        return 1;
+    }
+    char name[256] = "";
+    char signature[256] = "";
+    char description[256] = "";
+    if (!plugin.start(name, signature, description) || !plugin.enable()) {
+        fprintf(stderr, "Plugin failed to start\n");
+        return 1;
+    }
+    plugin.receive_message(XPLM_PLUGIN_XPLANE, XPLM_MSG_PLANE_LOADED, nullptr);
+
+    MicrobenchResult results[CASE_COUNT];
+    printf("%d engine(s), %ld iterations per case, %s values (ns per call)\n",
+           options.engines, options.iterations, options.static_values ? "static" : "varying");
+    printf("%-18s %8s %8s %8s %8s %8s %8s\n", "case", "wall", "total", "sample", "labels", "control", "record");
+    for (int i = 0; i < CASE_COUNT; i++) {
+        results[i] = RunCase(CASES[i], options);
+        const MicrobenchResult& r = results[i];
+        printf("%-18s %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+               CASES[i].name, r.wall, r.total, r.sample, r.labels, r.control, r.record);
+    }
+
+    UnloadPlugin(&plugin);
+
+    if (options.json_path) {
+        FILE* out = fopen(options.json_path, "w");
+        if (!out) {
+            fprintf(stderr, "Cannot write %s\n", options.json_path);
+            return 1;
+        }
+        fprintf(out, "{\n  \"engines\": %d,\n  \"iterations\": %ld,\n  \"static_values\": %s,\n  \"cases\": [\n",
+                options.engines, options.iterations, options.static_values ? "true" : "false");
+        for (int i = 0; i < CASE_COUNT; i++) {
+            const MicrobenchResult& r = results[i];
+            fprintf(out, "    { \"name\": \"%s\", \"wall_ns\": %.1f, \"total_ns\": %.1f, \"sample_ns\": %.1f, "
+                         "\"labels_ns\": %.1f, \"control_ns\": %.1f, \"record_ns\": %.1f }%s\n",
+                    CASES[i].name, r.wall, r.total, r.sample, r.labels, r.control, r.record,
+                    (i + 1 < CASE_COUNT) ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+        fclose(out);
+    }
+    return 0;
+}
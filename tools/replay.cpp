@@ -0,0 +1,214 @@
+// Offline replay: feeds a recorded flight log through the autothrottle
+// control law and diffs the replayed throttle commands against the
+// recorded ones. With unchanged code and gains the two match, so any
+// difference is the effect of a tuning or control law change.
+//
+// Usage:
+//     xpat_replay LOG|DIR [--profile PATH] [--kp K] [--ki K] [--kd K]
+//                 [--tolerance T] [--adaptive 0|1] [--csv PATH]
+//
+// A directory replays the newest .xatlog in it. --profile loads the gains
+// and gain schedule of an aircraft's gain profile; options after it
+// override single gains.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+#include "controller.h"
+#include "flight_log.h"
+#include "gain_profile.h"
+
+struct ReplayOptions {
+    const char* log_path = nullptr;
+    PidGains gains = DefaultPidGains();
+    GainSchedule schedule = {};
+    PropGains prop = DefaultPropGains();
+    ActuatorLimits actuator = DefaultActuatorLimits();
+    float tolerance = 1e-4f;
+    const char* csv_path = nullptr;
+    int adaptive = -1;              // Gain adaptation 0/1, or -1 as recorded
+};
+
+struct ReplayStats {
+    long samples = 0;
+    long compared = 0;          // Engaged engine-samples compared
+    long mismatched = 0;        // ... differing by more than the tolerance
+    double sum_squared = 0.0;
+    float max_diff = 0.0f;
+    float max_diff_time = 0.0f;
+    float flight_time = 0.0f;
+};
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s LOG|DIR [--profile PATH] [--kp K] [--ki K] [--kd K] [--tolerance T]\n"
+            "       [--adaptive 0|1] [--csv PATH]\n",
+            argv0);
+}
+
+static bool ParseOptions(int argc, char** argv, ReplayOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (arg[0] != '-') {
+            options->log_path = arg;
+        } else if (!value) {
+            return false;
+        } else if (!strcmp(arg, "--profile")) {
+            GainProfile profile;
+            if (!LoadGainProfile(value, &profile)) {
+                fprintf(stderr, "Cannot load gain profile %s\n", value);
+                return false;
+            }
+            options->gains = profile.gains;
+            options->schedule = profile.schedule;
+            options->prop = profile.prop;
+            options->actuator = profile.actuator;
+            i++;
+        } else if (!strcmp(arg, "--kp")) {
+            options->gains.kp = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--ki")) {
+            options->gains.ki = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--kd")) {
+            options->gains.kd = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--tolerance")) {
+            options->tolerance = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--adaptive")) {
+            options->adaptive = atoi(value) != 0; i++;
+        } else if (!strcmp(arg, "--csv")) {
+            options->csv_path = value; i++;
+        } else {
+            return false;
+        }
+    }
+    return options->log_path != nullptr;
+}
+
+// Resolve a directory to its newest flight log. Log names carry their start
+// time, so the greatest name is the newest.
+static std::string ResolveLogPath(const char* path) {
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error)) {
+        return path;
+    }
+    std::string newest;
+    for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+        if (entry.path().extension() == ".xatlog" && entry.path().string() > newest) {
+            newest = entry.path().string();
+        }
+    }
+    return newest;
+}
+
+static void Replay(FILE* log, const FlightLogHeader& header, FILE* csv, const ReplayOptions& options, ReplayStats* stats) {
+    Autothrottle autothrottle = {};
+    EngineState state = {};
+    FlightLogSample sample;
+
+    while (FlightLogReadSample(log, header, &sample)) {
+        state.num_engines = sample.num_engines;
+        state.sample_time = sample.sample_time;
+        state.dt = sample.dt;
+        state.target_rpm = (int)sample.target_rpm;
+        state.target_prop_rpm = (int)sample.target_prop_rpm;
+        state.density_altitude_ft = sample.density_altitude_ft;
+        state.indicated_airspeed_kt = sample.indicated_airspeed_kt;
+        state.rpm_valid = (sample.flags & FLIGHT_LOG_RPM_VALID) != 0;
+        state.throttle_valid = (sample.flags & FLIGHT_LOG_THROTTLE_VALID) != 0;
+        for (int i = 0; i < sample.num_engines; i++) {
+            state.rpm[i] = sample.rpm[i];
+            state.throttle[i] = sample.throttle[i];
+        }
+
+        bool engaged = (sample.flags & FLIGHT_LOG_ENGAGED) != 0;
+        autothrottle.adaptive = (options.adaptive >= 0) ? options.adaptive != 0 : (sample.flags & FLIGHT_LOG_ADAPTIVE) != 0;
+        PidGains gains = GainScheduleApply(options.schedule, options.gains, state.density_altitude_ft, state.indicated_airspeed_kt);
+        AutothrottleAction action = AutothrottleStep(&autothrottle, state, engaged, gains, DefaultSpeedGains(), options.prop, options.actuator);
+
+        stats->samples++;
+        stats->flight_time = sample.sample_time;
+        if (action == AUTOTHROTTLE_OFF) {
+            continue;
+        }
+
+        for (int i = 0; i < sample.num_engines; i++) {
+            float replayed = autothrottle.actuator.position[i];
+            float diff = fabsf(replayed - sample.commanded_throttle[i]);
+            stats->compared++;
+            stats->sum_squared += (double)diff * diff;
+            if (diff > options.tolerance) {
+                stats->mismatched++;
+            }
+            if (diff > stats->max_diff) {
+                stats->max_diff = diff;
+                stats->max_diff_time = sample.sample_time;
+            }
+        }
+        if (csv) {
+            fprintf(csv, "%.3f,%.0f,%.1f,%.4f,%.4f\n", sample.sample_time, sample.target_rpm,
+                    sample.rpm[0], sample.commanded_throttle[0], autothrottle.actuator.position[0]);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::string path = ResolveLogPath(options.log_path);
+    FILE* log = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!log) {
+        fprintf(stderr, "No flight log at %s\n", options.log_path);
+        return 1;
+    }
+
+    // Logs are read sequentially; a large buffer keeps a 2 hour flight to a
+    // handful of reads
+    static char buffer[1 << 20];
+    setvbuf(log, buffer, _IOFBF, sizeof(buffer));
+
+    FlightLogHeader header;
+    if (!FlightLogReadHeader(log, &header)) {
+        fprintf(stderr, "%s is not a supported flight log\n", path.c_str());
+        fclose(log);
+        return 1;
+    }
+
+    FILE* csv = nullptr;
+    if (options.csv_path) {
+        csv = fopen(options.csv_path, "w");
+        if (!csv) {
+            fprintf(stderr, "Cannot write %s\n", options.csv_path);
+            fclose(log);
+            return 1;
+        }
+        fprintf(csv, "time,target_rpm,rpm,recorded_throttle,replayed_throttle\n");
+    }
+
+    ReplayStats stats;
+    auto start = std::chrono::steady_clock::now();
+    Replay(log, header, csv, options, &stats);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fclose(log);
+    if (csv) {
+        fclose(csv);
+    }
+
+    float rms = (stats.compared > 0) ? (float)sqrt(stats.sum_squared / stats.compared) : 0.0f;
+    printf("Replayed %s: %ld samples, %.1f s of flight in %.3f s\n",
+           path.c_str(), stats.samples, stats.flight_time, elapsed);
+    printf("Throttle diff: %ld compared, %ld over %.1e, rms %.2e, max %.2e at t=%.2f\n",
+           stats.compared, stats.mismatched, options.tolerance, rms, stats.max_diff, stats.max_diff_time);
+
+    return (stats.mismatched > 0) ? 1 : 0;
+}
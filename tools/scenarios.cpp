@@ -0,0 +1,227 @@
+#include <cmath>
+
+#include "scenarios.h"
+
+// Matches the plugin's low-rate interval once the engines are in tolerance
+const float LOOP_INTERVAL_IDLE = 0.1f;
+
+// Window at the end of a scenario used for the steady-state error
+const float STEADY_STATE_WINDOW = 5.0f;
+
+const Scenario SCENARIOS[] = {
+    { "preset_up", "1000 -> 2400 preset step at 50 kt",
+      1, 30.0f, 50.0f, 1.0f, { 1000.0f, 0.0f }, 1000.0f, 1.0f, 2400.0f,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { "preset_down", "2400 -> 1000 preset step at 50 kt",
+      1, 30.0f, 50.0f, 1.0f, { 2400.0f, 0.0f }, 2400.0f, 1.0f, 1000.0f,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { "preset_up_high", "1800 -> 2400 step at 12,000 ft density altitude and 110 kt TAS",
+      1, 30.0f, 110.0f, 0.693f, { 1800.0f, 0.0f }, 1800.0f, 1.0f, 2400.0f,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { "climb", "Hold 2400 while slowing 100 -> 75 kt and climbing to 0.75 density",
+      1, 90.0f, 100.0f, 1.0f, { 2400.0f, 0.0f }, 2400.0f, 0, 0,
+      5.0f, 65.0f, 75.0f, 0.75f, 0, 0, 0, 0, 0, 0, 0 },
+    { "descent", "Hold 2300 while accelerating 75 -> 120 kt and descending to 1.0 density",
+      1, 90.0f, 75.0f, 0.75f, { 2300.0f, 0.0f }, 2300.0f, 0, 0,
+      5.0f, 65.0f, 120.0f, 1.0f, 0, 0, 0, 0, 0, 0, 0 },
+    { "gusts", "Hold 2400 through +/-12 kt gusts with a 4 s period",
+      1, 40.0f, 100.0f, 1.0f, { 2400.0f, 0.0f }, 2400.0f, 0, 0,
+      0, 0, 0, 0, 5.0f, 25.0f, 12.0f, 4.0f, 0, 0, 0 },
+    { "throttle_override", "Pilot pulls the throttle to 40% for 5 s, disengaging the autothrottle, then re-engages",
+      1, 40.0f, 100.0f, 1.0f, { 2400.0f, 0.0f }, 2400.0f, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 5.0f, 10.0f, 0.4f },
+    { "twin_split", "Twin engaged with engines at 2100 and 2600, target 2400",
+      2, 30.0f, 120.0f, 1.0f, { 2100.0f, 2600.0f }, 2400.0f, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+};
+const int SCENARIO_COUNT = sizeof(SCENARIOS) / sizeof(SCENARIOS[0]);
+
+// Throttle giving a steady RPM at the model's airspeed and density
+static float ThrottleForRpm(const EngineModel& model, float rpm) {
+    float lo = 0.0f;
+    float hi = 1.0f;
+    for (int i = 0; i < 30; i++) {
+        float mid = 0.5f * (lo + hi);
+        if (EngineModelSteadyRpm(model, mid) < rpm) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0.5f * (lo + hi);
+}
+
+static float Lerp(float a, float b, float t) {
+    return a + (b - a) * fminf(fmaxf(t, 0.0f), 1.0f);
+}
+
+static void ApplyEnvironment(const Scenario& scenario, float t, EngineModel* model) {
+    float airspeed = scenario.airspeed_kt;
+    float density = scenario.density_ratio;
+    if (scenario.ramp_end > scenario.ramp_start) {
+        float fraction = (t - scenario.ramp_start) / (scenario.ramp_end - scenario.ramp_start);
+        airspeed = Lerp(scenario.airspeed_kt, scenario.ramp_airspeed_kt, fraction);
+        density = Lerp(scenario.density_ratio, scenario.ramp_density_ratio, fraction);
+    }
+    if (t >= scenario.gust_start && t < scenario.gust_end) {
+        airspeed += scenario.gust_kt * sinf(2.0f * (float)M_PI * (t - scenario.gust_start) / scenario.gust_period);
+    }
+    model->true_airspeed_kt = airspeed;
+    model->density_ratio = density;
+}
+
+// RPM target in effect at time t
+static int TargetAt(const Scenario& scenario, float t) {
+    if (scenario.step_target > 0.0f && t >= scenario.step_time) {
+        return (int)scenario.step_target;
+    }
+    return (int)scenario.target_rpm;
+}
+
+ScenarioResult RunScenario(const Scenario& scenario, const GainProfile& profile, const EngineModelParams& engine, float fps, bool adaptive) {
+    EngineModel model;
+    EngineModelInit(&model, engine, scenario.engines, 0.0f, scenario.airspeed_kt, scenario.density_ratio);
+    for (int i = 0; i < scenario.engines; i++) {
+        float rpm = (i > 0 && scenario.initial_rpm[1] > 0.0f) ? scenario.initial_rpm[1] : scenario.initial_rpm[0];
+        model.throttle[i] = ThrottleForRpm(model, rpm);
+        model.effective_throttle[i] = model.throttle[i];
+        model.rpm[i] = EngineModelSteadyRpm(model, model.throttle[i]);
+    }
+
+    const float dt = 1.0f / fps;
+    const long frames = (long)(scenario.duration * fps);
+    const bool has_override = scenario.override_end > scenario.override_start;
+    // Settling and overshoot count from the last target change, or from the
+    // hand-back when the pilot took the throttle
+    float reference_time = 0.0f;
+    if (scenario.step_target > 0.0f) {
+        reference_time = scenario.step_time;
+    } else if (has_override) {
+        reference_time = scenario.override_end;
+    }
+    // Gusts keep pushing the RPM out of the band, so settling counts from
+    // when they die down
+    const float settle_from = fmaxf(reference_time, scenario.gust_end);
+
+    Autothrottle autothrottle = {};
+    autothrottle.adaptive = adaptive;
+    EngineState state = {};
+    state.num_engines = scenario.engines;
+    state.rpm_valid = true;
+    state.throttle_valid = true;
+
+    ScenarioResult result = {};
+    float commanded[MAX_ENGINES];
+    for (int i = 0; i < scenario.engines; i++) {
+        commanded[i] = model.throttle[i];
+    }
+    bool engaged = true;
+    float override_reported = -1.0f;    // When the controller first saw the pilot's input
+    float past_target_sign = 0.0f;      // Direction of the error at the reference time
+    float last_call_time = 0.0f;
+    float next_call_time = 0.0f;
+    float last_out_of_band = settle_from;
+    bool reached_band = false;
+    long in_tolerance_frames = 0;
+    double steady_error_sum = 0.0;
+    long steady_error_count = 0;
+
+    for (long frame = 1; frame <= frames; frame++) {
+        const float t = frame * dt;
+        const float now = t - dt;   // Sim time the last frame left the model at
+        const int target = TargetAt(scenario, t);
+        bool overridden = t >= scenario.override_start && t < scenario.override_end;
+
+        // Before the flight model, at the rate the plugin would schedule:
+        // the command is flown in this frame's flight model step
+        const int control_target = TargetAt(scenario, now);
+        bool target_changed = control_target != state.target_rpm;
+        if (now + 0.5f * dt >= next_call_time || target_changed) {
+            for (int i = 0; i < scenario.engines; i++) {
+                state.rpm[i] = model.rpm[i];
+                state.throttle[i] = model.throttle[i];
+            }
+            state.target_rpm = control_target;
+            state.dt = now - last_call_time;
+            state.sample_time = now;
+            state.density_altitude_ft = DensityAltitudeFt(model.density_ratio);
+            state.indicated_airspeed_kt = IndicatedAirspeedKt(model.true_airspeed_kt, model.density_ratio);
+            last_call_time = now;
+
+            PidGains gains = GainScheduleApply(profile.schedule, profile.gains, state.density_altitude_ft, state.indicated_airspeed_kt);
+            // The pilot re-engages once they let go of the lever
+            if (!engaged && now >= scenario.override_end) {
+                engaged = true;
+            }
+            AutothrottleAction action = AutothrottleStep(&autothrottle, state, engaged, gains, profile.speed, profile.prop, profile.actuator);
+            if (action == AUTOTHROTTLE_COMMAND) {
+                for (int i = 0; i < scenario.engines; i++) {
+                    result.throttle_travel += fabsf(autothrottle.actuator.position[i] - commanded[i]);
+                    commanded[i] = autothrottle.actuator.position[i];
+                }
+            } else if (action == AUTOTHROTTLE_OVERRIDDEN) {
+                // Disengage and leave the levers where the pilot put them
+                engaged = false;
+                if (override_reported < 0.0f) {
+                    override_reported = now;
+                }
+                for (int i = 0; i < scenario.engines; i++) {
+                    commanded[i] = state.throttle[i];
+                }
+            }
+            result.controller_calls++;
+            bool every_frame = AutothrottleOutOfTolerance(autothrottle, state) || AutothrottleActuating(autothrottle);
+            next_call_time = now + (every_frame ? dt : LOOP_INTERVAL_IDLE);
+        }
+
+        // Flight model: the pilot's hand wins over any command
+        ApplyEnvironment(scenario, t, &model);
+        for (int i = 0; i < scenario.engines; i++) {
+            if (overridden) {
+                commanded[i] = scenario.override_throttle;
+            }
+            model.throttle[i] = commanded[i];
+        }
+        EngineModelStep(&model, dt);
+
+        // Metrics against the true plant RPM every frame
+        bool in_band = true;
+        for (int i = 0; i < scenario.engines; i++) {
+            float error = model.rpm[i] - (float)target;
+            in_band = in_band && fabsf(error) <= RPM_TOLERANCE;
+            if (t >= reference_time) {
+                if (reference_time > 0.0f && past_target_sign == 0.0f) {
+                    past_target_sign = (error <= 0.0f) ? 1.0f : -1.0f;
+                }
+                result.overshoot_rpm = fmaxf(result.overshoot_rpm, past_target_sign * error);
+                if (reached_band) {
+                    result.peak_error_rpm = fmaxf(result.peak_error_rpm, fabsf(error));
+                }
+            }
+            if (t > scenario.duration - STEADY_STATE_WINDOW) {
+                steady_error_sum += fabsf(error);
+                steady_error_count++;
+            }
+        }
+        if (in_band) {
+            in_tolerance_frames++;
+            reached_band = reached_band || t >= reference_time;
+        }
+        if (!in_band && t >= settle_from) {
+            last_out_of_band = t;
+        }
+    }
+
+    bool settled = reached_band && last_out_of_band < scenario.duration - STEADY_STATE_WINDOW;
+    result.settling_time = settled ? last_out_of_band - settle_from : -1.0f;
+    result.steady_state_error = steady_error_count ? (float)(steady_error_sum / steady_error_count) : 0.0f;
+    result.time_in_tolerance = frames ? (float)in_tolerance_frames / frames : 0.0f;
+    result.final_kp = autothrottle.gains.kp;
+    result.final_ki = autothrottle.gains.ki;
+    // The pilot's input must be seen at the first control call after the
+    // lever moved, and nothing commanded until they hand back
+    result.override_respected = !has_override ||
+        (override_reported >= scenario.override_start &&
+         override_reported <= scenario.override_start + LOOP_INTERVAL_IDLE + dt);
+    return result;
+}
@@ -0,0 +1,59 @@
+#ifndef SCENARIOS_H
+#define SCENARIOS_H
+
+#include "controller.h"
+#include "engine_model.h"
+#include "gain_profile.h"
+
+// Scripted closed-loop scenarios: the autothrottle control law flying the
+// engine model through target steps, climbs, descents, gusts and pilot
+// overrides. Shared by the benchmark and the gain tuner.
+
+// A scripted scenario. Zero durations disable the optional parts.
+struct Scenario {
+    const char* name;
+    const char* description;
+    int engines;
+    float duration;             // Seconds simulated
+    float airspeed_kt;          // Initial true airspeed
+    float density_ratio;        // Initial air density ratio
+    float initial_rpm[2];       // Steady RPM at engage (second entry: other engines, 0 = same)
+    float target_rpm;           // Target at engage
+    float step_time;            // Target change: time and new target
+    float step_target;
+    float ramp_start;           // Airspeed/density ramp (climb, descent)
+    float ramp_end;
+    float ramp_airspeed_kt;
+    float ramp_density_ratio;
+    float gust_start;           // Sinusoidal airspeed gusts
+    float gust_end;
+    float gust_kt;
+    float gust_period;
+    float override_start;       // Pilot holds the throttle; the autothrottle must disengage and re-engage after
+    float override_end;
+    float override_throttle;
+};
+
+// The scenario library
+extern const Scenario SCENARIOS[];
+extern const int SCENARIO_COUNT;
+
+struct ScenarioResult {
+    float settling_time;        // From the last target change, hand-back, end of gusts or engage; < 0 if never settled
+    float overshoot_rpm;        // Past the target after the step or hand-back
+    float peak_error_rpm;       // Largest error once first inside the band
+    float steady_state_error;   // Mean |error| over the last STEADY_STATE_WINDOW seconds
+    float time_in_tolerance;    // Fraction of the run with every engine in the band
+    float throttle_travel;      // Total commanded throttle movement, all engines
+    long controller_calls;
+    float final_kp;             // Gains flown at the end, after scheduling and adaptation
+    float final_ki;
+    bool override_respected;    // Pilot override seen promptly and the levers left alone (true without one)
+};
+
+// Fly one scenario at a fixed frame rate with the given gains (scheduled
+// by the flight condition) and engine. With adaptive set, the controller
+// retunes from its plant estimate.
+ScenarioResult RunScenario(const Scenario& scenario, const GainProfile& profile, const EngineModelParams& engine, float fps, bool adaptive);
+
+#endif // SCENARIOS_H
@@ -0,0 +1,101 @@
+#include <dlfcn.h>
+#include <stdio.h>
+
+#include <cmath>
+
+#include "XPLMDataAccess.h"
+
+#include "gain_schedule.h"
+#include "plugin.h"
+#include "sim_host.h"
+#include "xplm_stub.h"
+
+const char* DATAREF_ENGINE_RPM = "sim/cockpit2/engine/indicators/engine_speed_rpm";
+const char* DATAREF_ENGINE_N1 = "sim/cockpit2/engine/indicators/N1_percent";
+const char* DATAREF_ENGINE_TYPE = "sim/aircraft/prop/acf_en_type";
+const char* DATAREF_MANIFOLD = "sim/cockpit2/engine/indicators/MPR_in_hg";
+const char* DATAREF_PROP_TYPE = "sim/aircraft/prop/acf_prop_type";
+const char* DATAREF_PROP_RPM = "sim/cockpit2/engine/indicators/prop_speed_rpm";
+const char* DATAREF_PROP_LEVER = "sim/cockpit2/engine/actuators/prop_ratio";
+const char* DATAREF_THROTTLE = "sim/cockpit2/engine/actuators/throttle_ratio";
+const char* DATAREF_THROTTLE_ALL = "sim/cockpit2/engine/actuators/throttle_ratio_all";
+const char* DATAREF_THROTTLE_USED = "sim/flightmodel/engine/ENGN_thro_use";
+const char* DATAREF_OVERRIDE_THROTTLES = "sim/operation/override/override_throttles";
+const char* DATAREF_NUM_ENGINES = "sim/aircraft/engine/acf_num_engines";
+const char* DATAREF_AIR_DENSITY = "sim/weather/rho";
+const char* DATAREF_INDICATED_AIRSPEED = "sim/flightmodel/position/indicated_airspeed";
+const char* DATAREF_MACH = "sim/flightmodel/misc/machno";
+const char* DATAREF_SIM_TIME = "sim/time/total_running_time_sec";
+const char* DATAREF_PAUSED = "sim/time/paused";
+const char* DATAREF_REPLAY = "sim/operation/prefs/replay_mode";
+
+// ISA sea level speed of sound (kt)
+const float SEA_LEVEL_SPEED_OF_SOUND_KT = 661.47f;
+
+bool LoadPlugin(const char* path, LoadedPlugin* plugin) {
+    plugin->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!plugin->handle) {
+        fprintf(stderr, "Failed to load %s: %s\n", path, dlerror());
+        return false;
+    }
+    plugin->start = (XPluginStart_f)dlsym(plugin->handle, "XPluginStart");
+    plugin->stop = (XPluginStop_f)dlsym(plugin->handle, "XPluginStop");
+    plugin->enable = (XPluginEnable_f)dlsym(plugin->handle, "XPluginEnable");
+    plugin->disable = (XPluginDisable_f)dlsym(plugin->handle, "XPluginDisable");
+    plugin->receive_message = (XPluginReceiveMessage_f)dlsym(plugin->handle, "XPluginReceiveMessage");
+    if (!plugin->start || !plugin->stop || !plugin->enable || !plugin->disable || !plugin->receive_message) {
+        fprintf(stderr, "%s does not export the XPlugin entry points\n", path);
+        dlclose(plugin->handle);
+        return false;
+    }
+    StubSetMessageHandler(plugin->receive_message);
+    return true;
+}
+
+void UnloadPlugin(LoadedPlugin* plugin) {
+    StubSetMessageHandler(nullptr);
+    plugin->disable();
+    plugin->stop();
+    dlclose(plugin->handle);
+    plugin->handle = nullptr;
+}
+
+void DefineSimDatarefs(int engines, int engine_type, int prop_type) {
+    StubDefineDataRef(DATAREF_ENGINE_RPM, xplmType_FloatArray, MAX_ENGINES, false);
+    StubDefineDataRef(DATAREF_ENGINE_N1, xplmType_FloatArray, MAX_ENGINES, false);
+    StubDefineDataRef(DATAREF_MANIFOLD, xplmType_FloatArray, MAX_ENGINES, false);
+    StubDefineDataRef(DATAREF_PROP_RPM, xplmType_FloatArray, MAX_ENGINES, false);
+    StubDefineDataRef(DATAREF_PROP_LEVER, xplmType_FloatArray, MAX_ENGINES, true);
+    StubDefineDataRef(DATAREF_ENGINE_TYPE, xplmType_IntArray, MAX_ENGINES, false);
+    StubDefineDataRef(DATAREF_PROP_TYPE, xplmType_IntArray, MAX_ENGINES, false);
+    for (int i = 0; i < MAX_ENGINES; i++) {
+        StubIntData(DATAREF_ENGINE_TYPE)[i] = engine_type;
+        StubIntData(DATAREF_PROP_TYPE)[i] = prop_type;
+    }
+    StubDefineDataRef(DATAREF_THROTTLE, xplmType_FloatArray, MAX_ENGINES, true);
+    StubDefineDataRef(DATAREF_THROTTLE_ALL, xplmType_Float, 0, true);
+    StubDefineDataRef(DATAREF_THROTTLE_USED, xplmType_FloatArray, MAX_ENGINES, true);
+    StubDefineDataRef(DATAREF_OVERRIDE_THROTTLES, xplmType_Int, 0, true);
+    StubDefineDataRef(DATAREF_NUM_ENGINES, xplmType_Int, 0, false);
+    *StubIntData(DATAREF_NUM_ENGINES) = engines;
+    StubDefineDataRef(DATAREF_AIR_DENSITY, xplmType_Float, 0, false);
+    StubDefineDataRef(DATAREF_INDICATED_AIRSPEED, xplmType_Float, 0, false);
+    StubDefineDataRef(DATAREF_MACH, xplmType_Float, 0, false);
+    StubDefineDataRef(DATAREF_SIM_TIME, xplmType_Float, 0, false);
+    StubDefineDataRef(DATAREF_PAUSED, xplmType_Int, 0, true);
+    StubDefineDataRef(DATAREF_REPLAY, xplmType_Int, 0, true);
+    PublishAirData(0.0f, 1.0f);
+}
+
+void AdvanceSimTime(float dt) {
+    *StubFloatData(DATAREF_SIM_TIME) += dt;
+}
+
+void PublishAirData(float true_airspeed_kt, float density_ratio) {
+    *StubFloatData(DATAREF_AIR_DENSITY) = SEA_LEVEL_DENSITY * density_ratio;
+    *StubFloatData(DATAREF_INDICATED_AIRSPEED) = true_airspeed_kt * sqrtf(density_ratio);
+
+    // Temperature ratio from the troposphere's sigma = theta ^ 4.2559
+    float theta = powf(fmaxf(density_ratio, 0.0f), 0.234969f);
+    *StubFloatData(DATAREF_MACH) = true_airspeed_kt / (SEA_LEVEL_SPEED_OF_SOUND_KT * sqrtf(theta));
+}
@@ -0,0 +1,63 @@
+#ifndef SIM_HOST_H
+#define SIM_HOST_H
+
+#include "XPLMDefs.h"
+
+// Host-side helpers shared by the tools that load the plugin against the
+// XPLM stub: loading the .xpl and publishing the sim datarefs it reads.
+
+typedef int (*XPluginStart_f)(char*, char*, char*);
+typedef void (*XPluginStop_f)(void);
+typedef int (*XPluginEnable_f)(void);
+typedef void (*XPluginDisable_f)(void);
+typedef void (*XPluginReceiveMessage_f)(XPLMPluginID, int, void*);
+
+struct LoadedPlugin {
+    void* handle;
+    XPluginStart_f start;
+    XPluginStop_f stop;
+    XPluginEnable_f enable;
+    XPluginDisable_f disable;
+    XPluginReceiveMessage_f receive_message;
+};
+
+extern const char* DATAREF_ENGINE_RPM;
+extern const char* DATAREF_ENGINE_N1;
+extern const char* DATAREF_ENGINE_TYPE;
+extern const char* DATAREF_MANIFOLD;
+extern const char* DATAREF_PROP_TYPE;
+extern const char* DATAREF_PROP_RPM;
+extern const char* DATAREF_PROP_LEVER;
+extern const char* DATAREF_THROTTLE;
+extern const char* DATAREF_THROTTLE_ALL;
+extern const char* DATAREF_THROTTLE_USED;
+extern const char* DATAREF_OVERRIDE_THROTTLES;
+extern const char* DATAREF_NUM_ENGINES;
+extern const char* DATAREF_AIR_DENSITY;
+extern const char* DATAREF_INDICATED_AIRSPEED;
+extern const char* DATAREF_MACH;
+extern const char* DATAREF_SIM_TIME;
+extern const char* DATAREF_PAUSED;
+extern const char* DATAREF_REPLAY;
+
+// dlopen the plugin, resolve its entry points and route the stub's
+// messages to it. Prints the reason and returns false on failure.
+bool LoadPlugin(const char* path, LoadedPlugin* plugin);
+
+// Disable, stop and unload a started plugin
+void UnloadPlugin(LoadedPlugin* plugin);
+
+// Define the sim-owned engine and air data datarefs for an aircraft with
+// this many engines of an X-Plane engine type (0 for a piston) and prop
+// type (0 fixed pitch, 1 constant speed)
+void DefineSimDatarefs(int engines, int engine_type = 0, int prop_type = 0);
+
+// Advance the sim clock (sim/time/total_running_time_sec) by dt seconds of
+// physics
+void AdvanceSimTime(float dt);
+
+// Publish air density, indicated airspeed and Mach number for a true
+// airspeed and density ratio in the ISA troposphere
+void PublishAirData(float true_airspeed_kt, float density_ratio);
+
+#endif // SIM_HOST_H
@@ -0,0 +1,294 @@
+// Offline gain tuner: sweeps a grid of PID gains, flies every benchmark
+// scenario against the engine model for each set on all cores, scores the
+// sets on settling time, overshoot and actuator activity, and writes the
+// Pareto-optimal sets as a gain profile the plugin loads from the
+// aircraft's folder.
+//
+// Usage:
+//     xpat_tuner [--kp MIN:MAX:N] [--ki MIN:MAX:N] [--kd MIN:MAX:N]
+//                [--rate-limit MIN:MAX:N] [--threads N] [--fps F]
+//                [--inertia I] [--throttle-lag S] [--output PATH]
+//                [--csv PATH]
+//
+// Ranges with a positive minimum are log-spaced, otherwise linear. The
+// actuator caps the command at its own rate, so the swept rate limit sets
+// the lever's rate limit (throttle_rate_limit) along with the PID's.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "controller.h"
+#include "engine_model.h"
+#include "gain_profile.h"
+#include "scenarios.h"
+#include "work_pool.h"
+
+struct SweepRange {
+    float min;
+    float max;
+    int steps;
+};
+
+struct TunerOptions {
+    SweepRange kp = { 0.0002f, 0.002f, 8 };
+    SweepRange ki = { 0.0002f, 0.002f, 8 };
+    SweepRange kd = { 0.0f, 0.0001f, 5 };
+    SweepRange rate_limit = { 0.25f, 1.0f, 4 };
+    int threads = 0;
+    float fps = 60.0f;
+    EngineModelParams engine = DefaultEngineModelParams();
+    const char* output_path = GAIN_PROFILE_FILE_NAME;
+    const char* csv_path = nullptr;
+};
+
+// Objectives, all minimised
+struct TunerScore {
+    float settling_time;    // Mean over scenarios; unsettled scenarios count their full duration
+    float overshoot;        // Worst overshoot past the target across scenarios (RPM)
+    float activity;         // Total throttle travel across scenarios
+    bool feasible;          // Every scenario ended with a steady-state error inside the band
+};
+
+struct Candidate {
+    PidGains gains;
+    ActuatorLimits actuator;
+    TunerScore score;
+};
+
+static bool ParseRange(const char* text, SweepRange* range) {
+    SweepRange parsed;
+    if (sscanf(text, "%f:%f:%d", &parsed.min, &parsed.max, &parsed.steps) != 3 ||
+        parsed.steps < 1 || parsed.min < 0.0f || parsed.max < parsed.min) {
+        return false;
+    }
+    *range = parsed;
+    return true;
+}
+
+static float RangeValue(const SweepRange& range, int index) {
+    if (range.steps == 1) {
+        return range.min;
+    }
+    float fraction = (float)index / (float)(range.steps - 1);
+    if (range.min > 0.0f) {
+        return range.min * powf(range.max / range.min, fraction);
+    }
+    return range.min + (range.max - range.min) * fraction;
+}
+
+static void Usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--kp MIN:MAX:N] [--ki MIN:MAX:N] [--kd MIN:MAX:N] [--rate-limit MIN:MAX:N]\n"
+            "       [--threads N] [--fps F] [--inertia I] [--throttle-lag S] [--output PATH] [--csv PATH]\n",
+            argv0);
+}
+
+static bool ParseOptions(int argc, char** argv, TunerOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (!value) {
+            return false;
+        } else if (!strcmp(arg, "--kp")) {
+            ok = ParseRange(value, &options->kp); i++;
+        } else if (!strcmp(arg, "--ki")) {
+            ok = ParseRange(value, &options->ki); i++;
+        } else if (!strcmp(arg, "--kd")) {
+            ok = ParseRange(value, &options->kd); i++;
+        } else if (!strcmp(arg, "--rate-limit")) {
+            ok = ParseRange(value, &options->rate_limit); i++;
+        } else if (!strcmp(arg, "--threads")) {
+            options->threads = atoi(value); i++;
+        } else if (!strcmp(arg, "--fps")) {
+            options->fps = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--inertia")) {
+            options->engine.inertia = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--throttle-lag")) {
+            options->engine.throttle_lag = (float)atof(value); i++;
+        } else if (!strcmp(arg, "--output")) {
+            options->output_path = value; i++;
+        } else if (!strcmp(arg, "--csv")) {
+            options->csv_path = value; i++;
+        } else {
+            return false;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return options->fps > 0.0f && options->engine.inertia > 0.0f;
+}
+
+static TunerScore ScoreGains(const Candidate& candidate, const TunerOptions& options) {
+    TunerScore score = { 0.0f, 0.0f, 0.0f, true };
+    GainProfile profile = DefaultGainProfile();
+    profile.gains = candidate.gains;
+    profile.actuator = candidate.actuator;
+    for (int s = 0; s < SCENARIO_COUNT; s++) {
+        ScenarioResult result = RunScenario(SCENARIOS[s], profile, options.engine, options.fps, false);
+        score.settling_time += (result.settling_time >= 0.0f) ? result.settling_time : SCENARIOS[s].duration;
+        score.overshoot = fmaxf(score.overshoot, result.overshoot_rpm);
+        score.activity += result.throttle_travel;
+        score.feasible = score.feasible && result.steady_state_error <= RPM_TOLERANCE;
+    }
+    score.settling_time /= SCENARIO_COUNT;
+    return score;
+}
+
+static bool Dominates(const TunerScore& a, const TunerScore& b) {
+    bool no_worse = a.settling_time <= b.settling_time && a.overshoot <= b.overshoot && a.activity <= b.activity;
+    bool better = a.settling_time < b.settling_time || a.overshoot < b.overshoot || a.activity < b.activity;
+    return no_worse && better;
+}
+
+static std::vector<Candidate> ParetoFront(const std::vector<Candidate>& candidates) {
+    std::vector<Candidate> front;
+    for (const Candidate& candidate : candidates) {
+        if (!candidate.score.feasible) {
+            continue;
+        }
+        bool dominated = false;
+        for (const Candidate& other : candidates) {
+            if (other.score.feasible && Dominates(other.score, candidate.score)) {
+                dominated = true;
+                break;
+            }
+        }
+        if (!dominated) {
+            front.push_back(candidate);
+        }
+    }
+    std::sort(front.begin(), front.end(), [](const Candidate& a, const Candidate& b) {
+        return a.score.settling_time < b.score.settling_time;
+    });
+    return front;
+}
+
+// The knee of the front: smallest sum of objectives normalised to the
+// front's range
+static int PickKnee(const std::vector<Candidate>& front) {
+    TunerScore lo = front[0].score;
+    TunerScore hi = front[0].score;
+    for (const Candidate& c : front) {
+        lo.settling_time = fminf(lo.settling_time, c.score.settling_time);
+        lo.overshoot = fminf(lo.overshoot, c.score.overshoot);
+        lo.activity = fminf(lo.activity, c.score.activity);
+        hi.settling_time = fmaxf(hi.settling_time, c.score.settling_time);
+        hi.overshoot = fmaxf(hi.overshoot, c.score.overshoot);
+        hi.activity = fmaxf(hi.activity, c.score.activity);
+    }
+    auto normalise = [](float value, float min, float max) {
+        return (max > min) ? (value - min) / (max - min) : 0.0f;
+    };
+
+    int best = 0;
+    float best_cost = INFINITY;
+    for (size_t i = 0; i < front.size(); i++) {
+        const TunerScore& s = front[i].score;
+        float cost = normalise(s.settling_time, lo.settling_time, hi.settling_time) +
+                     normalise(s.overshoot, lo.overshoot, hi.overshoot) +
+                     normalise(s.activity, lo.activity, hi.activity);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+static bool WriteProfile(const char* path, const std::vector<Candidate>& front, int chosen, const TunerOptions& options, int evaluated) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "# XPAutoThrottle gain profile written by xpat_tuner\n");
+    fprintf(file, "# %d gain sets x %d scenarios, engine inertia %g, throttle lag %g s\n",
+            evaluated, SCENARIO_COUNT, options.engine.inertia, options.engine.throttle_lag);
+    fprintf(file, "#\n# Pareto-optimal sets (copy one below to use it instead):\n");
+    fprintf(file, "#   %-10s %-10s %-10s %-10s %8s %9s %8s\n", "kp", "ki", "kd", "rate_limit", "settle_s", "overshoot", "travel");
+    for (size_t i = 0; i < front.size(); i++) {
+        const Candidate& c = front[i];
+        fprintf(file, "# %c %-10g %-10g %-10g %-10g %8.2f %9.1f %8.3f\n", (int)i == chosen ? '*' : ' ',
+                c.gains.kp, c.gains.ki, c.gains.kd, c.gains.rate_limit,
+                c.score.settling_time, c.score.overshoot, c.score.activity);
+    }
+    fprintf(file, "#\n# Selected (*): the knee of the front\n");
+    WriteGainProfile(file, front[chosen].gains, front[chosen].actuator);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    TunerOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        Usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<Candidate> candidates;
+    for (int a = 0; a < options.kp.steps; a++) {
+        for (int b = 0; b < options.ki.steps; b++) {
+            for (int c = 0; c < options.kd.steps; c++) {
+                for (int d = 0; d < options.rate_limit.steps; d++) {
+                    Candidate candidate = {};
+                    candidate.gains = DefaultPidGains();
+                    candidate.gains.kp = RangeValue(options.kp, a);
+                    candidate.gains.ki = RangeValue(options.ki, b);
+                    candidate.gains.kd = RangeValue(options.kd, c);
+                    candidate.gains.rate_limit = RangeValue(options.rate_limit, d);
+                    candidate.actuator = DefaultActuatorLimits();
+                    candidate.actuator.rate_limit = candidate.gains.rate_limit;
+                    candidates.push_back(candidate);
+                }
+            }
+        }
+    }
+
+    const int threads = (options.threads > 0) ? options.threads : DefaultThreadCount();
+    printf("Evaluating %zu gain sets x %d scenarios on %d threads\n", candidates.size(), SCENARIO_COUNT, threads);
+
+    auto start = std::chrono::steady_clock::now();
+    ParallelFor((int)candidates.size(), threads, [&](int i) {
+        candidates[i].score = ScoreGains(candidates[i], options);
+    });
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.csv_path) {
+        FILE* csv = fopen(options.csv_path, "w");
+        if (csv) {
+            fprintf(csv, "kp,ki,kd,rate_limit,settling_time,overshoot,activity,feasible\n");
+            for (const Candidate& c : candidates) {
+                fprintf(csv, "%g,%g,%g,%g,%.3f,%.2f,%.4f,%d\n", c.gains.kp, c.gains.ki, c.gains.kd, c.gains.rate_limit,
+                        c.score.settling_time, c.score.overshoot, c.score.activity, c.score.feasible ? 1 : 0);
+            }
+            fclose(csv);
+        }
+    }
+
+    std::vector<Candidate> front = ParetoFront(candidates);
+    printf("Done in %.1f s, %zu Pareto-optimal sets\n", elapsed, front.size());
+    if (front.empty()) {
+        fprintf(stderr, "No gain set held every scenario within tolerance\n");
+        return 1;
+    }
+
+    int chosen = PickKnee(front);
+    const Candidate& knee = front[chosen];
+    printf("Selected kp %g ki %g kd %g rate_limit %g: settle %.2f s, overshoot %.1f RPM, travel %.3f\n",
+           knee.gains.kp, knee.gains.ki, knee.gains.kd, knee.gains.rate_limit,
+           knee.score.settling_time, knee.score.overshoot, knee.score.activity);
+
+    if (!WriteProfile(options.output_path, front, chosen, options, (int)candidates.size())) {
+        fprintf(stderr, "Cannot write %s\n", options.output_path);
+        return 1;
+    }
+    printf("Wrote %s\n", options.output_path);
+    return 0;
+}
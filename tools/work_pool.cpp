@@ -0,0 +1,95 @@
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "work_pool.h"
+
+// One worker's queue of indices. Tasks here are whole simulations (well
+// over a millisecond), so a mutex per deque costs nothing measurable.
+struct WorkQueue {
+    std::mutex mutex;
+    std::deque<int> tasks;
+};
+
+// Own work comes off the back, keeping a worker on neighbouring indices
+static bool PopOwn(WorkQueue* queue, int* task) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty()) {
+        return false;
+    }
+    *task = queue->tasks.back();
+    queue->tasks.pop_back();
+    return true;
+}
+
+// Thieves take from the front, the work the owner would reach last
+static bool Steal(WorkQueue* queue, int* task) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty()) {
+        return false;
+    }
+    *task = queue->tasks.front();
+    queue->tasks.pop_front();
+    return true;
+}
+
+static void Worker(int self, std::vector<std::unique_ptr<WorkQueue>>* queues, const std::function<void(int)>& body) {
+    const int worker_count = (int)queues->size();
+    int task;
+    for (;;) {
+        if (PopOwn((*queues)[self].get(), &task)) {
+            body(task);
+            continue;
+        }
+
+        // Nothing is ever added after the start, so once a full pass over
+        // the other queues finds nothing the range is done
+        bool stolen = false;
+        for (int offset = 1; offset < worker_count && !stolen; offset++) {
+            stolen = Steal((*queues)[(self + offset) % worker_count].get(), &task);
+        }
+        if (!stolen) {
+            return;
+        }
+        body(task);
+    }
+}
+
+int DefaultThreadCount(void) {
+    unsigned int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? (int)threads : 1;
+}
+
+void ParallelFor(int count, int threads, const std::function<void(int)>& body) {
+    if (count <= 0) {
+        return;
+    }
+    if (threads <= 0) {
+        threads = DefaultThreadCount();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    for (int t = 0; t < threads; t++) {
+        queues.emplace_back(new WorkQueue());
+        int begin = (int)((long long)count * t / threads);
+        int end = (int)((long long)count * (t + 1) / threads);
+        for (int i = begin; i < end; i++) {
+            queues.back()->tasks.push_back(i);
+        }
+    }
+
+    // The calling thread works as worker 0
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(Worker, t, &queues, std::cref(body));
+    }
+    Worker(0, &queues, body);
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
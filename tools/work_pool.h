@@ -0,0 +1,18 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <functional>
+
+// Work-stealing parallel for: runs body(i) for every i in [0, count) on
+// up to `threads` threads (0 = one per hardware thread).
+//
+// Each worker starts with a contiguous slice of the range in its own
+// deque and takes from the back of it; a worker that runs dry steals from
+// the front of another worker's deque, so uneven task costs still keep
+// every core busy. Returns when every index has run.
+void ParallelFor(int count, int threads, const std::function<void(int)>& body);
+
+// Threads ParallelFor uses for threads = 0
+int DefaultThreadCount(void);
+
+#endif // WORK_POOL_H
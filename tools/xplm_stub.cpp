@@ -0,0 +1,762 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "XPLMDataAccess.h"
+#include "XPLMMenus.h"
+#include "XPLMPlanes.h"
+#include "XPLMPlugin.h"
+#include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+#include "XPStandardWidgets.h"
+#include "XPWidgets.h"
+
+#include "xplm_stub.h"
+
+// ---------------------------------------------------------------------------
+// Datarefs
+
+struct StubDataRef {
+    std::string name;
+    XPLMDataTypeID type = xplmType_Unknown;
+    bool writable = false;
+    bool hidden = false;
+
+    // Sim-owned storage
+    bool owned = false;
+    int int_value = 0;
+    float float_value = 0.0f;
+    double double_value = 0.0;
+    std::vector<int> int_array;
+    std::vector<float> float_array;
+
+    // Plugin-published accessors
+    XPLMGetDatai_f read_int = nullptr;
+    XPLMSetDatai_f write_int = nullptr;
+    XPLMGetDataf_f read_float = nullptr;
+    XPLMSetDataf_f write_float = nullptr;
+    XPLMGetDatad_f read_double = nullptr;
+    XPLMSetDatad_f write_double = nullptr;
+    XPLMGetDatavi_f read_int_array = nullptr;
+    XPLMSetDatavi_f write_int_array = nullptr;
+    XPLMGetDatavf_f read_float_array = nullptr;
+    XPLMSetDatavf_f write_float_array = nullptr;
+    XPLMGetDatab_f read_data = nullptr;
+    XPLMSetDatab_f write_data = nullptr;
+    void* read_refcon = nullptr;
+    void* write_refcon = nullptr;
+};
+
+static std::map<std::string, std::unique_ptr<StubDataRef>> g_datarefs;
+static bool g_datarefs_added = false;     // Since the last XPLM_MSG_DATAREFS_ADDED
+static StubMessageHandler_f g_message_handler = nullptr;
+
+static StubDataRef* FindStubDataRef(const char* name) {
+    auto it = g_datarefs.find(name);
+    return (it == g_datarefs.end()) ? nullptr : it->second.get();
+}
+
+static StubDataRef* AsStub(XPLMDataRef ref) {
+    return static_cast<StubDataRef*>(ref);
+}
+
+void StubDefineDataRef(const char* name, XPLMDataTypeID type, int array_size, bool writable) {
+    std::unique_ptr<StubDataRef> ref(new StubDataRef());
+    ref->name = name;
+    ref->type = type;
+    ref->writable = writable;
+    ref->owned = true;
+    if (type & xplmType_IntArray) {
+        ref->int_array.assign(array_size, 0);
+    }
+    if (type & xplmType_FloatArray) {
+        ref->float_array.assign(array_size, 0.0f);
+    }
+    g_datarefs[name] = std::move(ref);
+    g_datarefs_added = true;
+}
+
+void StubSetMessageHandler(StubMessageHandler_f handler) {
+    g_message_handler = handler;
+}
+
+void StubHideDataRef(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (ref) {
+        ref->hidden = true;
+    }
+}
+
+void StubPublishDataRef(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (ref && ref->hidden) {
+        ref->hidden = false;
+        g_datarefs_added = true;
+    }
+}
+
+float* StubFloatData(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (!ref || !ref->owned) {
+        return nullptr;
+    }
+    if (ref->type & xplmType_FloatArray) {
+        return ref->float_array.data();
+    }
+    if (ref->type & xplmType_Float) {
+        return &ref->float_value;
+    }
+    return nullptr;
+}
+
+int* StubIntData(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (!ref || !ref->owned) {
+        return nullptr;
+    }
+    if (ref->type & xplmType_IntArray) {
+        return ref->int_array.data();
+    }
+    if (ref->type & xplmType_Int) {
+        return &ref->int_value;
+    }
+    return nullptr;
+}
+
+float StubGetFloat(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    return ref ? XPLMGetDataf(ref) : 0.0f;
+}
+
+int StubGetInt(const char* name) {
+    StubDataRef* ref = FindStubDataRef(name);
+    return ref ? XPLMGetDatai(ref) : 0;
+}
+
+void StubSetFloat(const char* name, float value) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (ref) {
+        XPLMSetDataf(ref, value);
+    }
+}
+
+void StubSetInt(const char* name, int value) {
+    StubDataRef* ref = FindStubDataRef(name);
+    if (ref) {
+        XPLMSetDatai(ref, value);
+    }
+}
+
+XPLMDataRef XPLMFindDataRef(const char* inDataRefName) {
+    StubDataRef* ref = FindStubDataRef(inDataRefName);
+    return (ref && !ref->hidden) ? ref : nullptr;
+}
+
+int XPLMCanWriteDataRef(XPLMDataRef inDataRef) {
+    return inDataRef && AsStub(inDataRef)->writable;
+}
+
+int XPLMIsDataRefGood(XPLMDataRef inDataRef) {
+    return inDataRef != nullptr;
+}
+
+XPLMDataTypeID XPLMGetDataRefTypes(XPLMDataRef inDataRef) {
+    return inDataRef ? AsStub(inDataRef)->type : xplmType_Unknown;
+}
+
+int XPLMGetDatai(XPLMDataRef inDataRef) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref) return 0;
+    if (ref->read_int) return ref->read_int(ref->read_refcon);
+    return ref->owned ? ref->int_value : 0;
+}
+
+void XPLMSetDatai(XPLMDataRef inDataRef, int inValue) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable) return;
+    if (ref->write_int) ref->write_int(ref->write_refcon, inValue);
+    else if (ref->owned) ref->int_value = inValue;
+}
+
+float XPLMGetDataf(XPLMDataRef inDataRef) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref) return 0.0f;
+    if (ref->read_float) return ref->read_float(ref->read_refcon);
+    return ref->owned ? ref->float_value : 0.0f;
+}
+
+void XPLMSetDataf(XPLMDataRef inDataRef, float inValue) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable) return;
+    if (ref->write_float) ref->write_float(ref->write_refcon, inValue);
+    else if (ref->owned) ref->float_value = inValue;
+}
+
+double XPLMGetDatad(XPLMDataRef inDataRef) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref) return 0.0;
+    if (ref->read_double) return ref->read_double(ref->read_refcon);
+    return ref->owned ? ref->double_value : 0.0;
+}
+
+void XPLMSetDatad(XPLMDataRef inDataRef, double inValue) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable) return;
+    if (ref->write_double) ref->write_double(ref->write_refcon, inValue);
+    else if (ref->owned) ref->double_value = inValue;
+}
+
+template <typename T>
+static int ReadArray(const std::vector<T>& storage, T* outValues, int inOffset, int inMax) {
+    int size = (int)storage.size();
+    if (!outValues) return size;
+    if (inOffset < 0 || inOffset >= size) return 0;
+    int count = (size - inOffset < inMax) ? size - inOffset : inMax;
+    memcpy(outValues, storage.data() + inOffset, count * sizeof(T));
+    return count;
+}
+
+template <typename T>
+static void WriteArray(std::vector<T>& storage, const T* inValues, int inOffset, int inCount) {
+    int size = (int)storage.size();
+    if (inOffset < 0 || inOffset >= size) return;
+    int count = (size - inOffset < inCount) ? size - inOffset : inCount;
+    memcpy(storage.data() + inOffset, inValues, count * sizeof(T));
+}
+
+int XPLMGetDatavi(XPLMDataRef inDataRef, int* outValues, int inOffset, int inMax) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref) return 0;
+    if (ref->read_int_array) return ref->read_int_array(ref->read_refcon, outValues, inOffset, inMax);
+    return ref->owned ? ReadArray(ref->int_array, outValues, inOffset, inMax) : 0;
+}
+
+void XPLMSetDatavi(XPLMDataRef inDataRef, int* inValues, int inOffset, int inCount) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable) return;
+    if (ref->write_int_array) ref->write_int_array(ref->write_refcon, inValues, inOffset, inCount);
+    else if (ref->owned) WriteArray(ref->int_array, inValues, inOffset, inCount);
+}
+
+int XPLMGetDatavf(XPLMDataRef inDataRef, float* outValues, int inOffset, int inMax) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref) return 0;
+    if (ref->read_float_array) return ref->read_float_array(ref->read_refcon, outValues, inOffset, inMax);
+    return ref->owned ? ReadArray(ref->float_array, outValues, inOffset, inMax) : 0;
+}
+
+void XPLMSetDatavf(XPLMDataRef inDataRef, float* inValues, int inOffset, int inCount) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable) return;
+    if (ref->write_float_array) ref->write_float_array(ref->write_refcon, inValues, inOffset, inCount);
+    else if (ref->owned) WriteArray(ref->float_array, inValues, inOffset, inCount);
+}
+
+int XPLMGetDatab(XPLMDataRef inDataRef, void* outValue, int inOffset, int inMaxBytes) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->read_data) return 0;
+    return ref->read_data(ref->read_refcon, outValue, inOffset, inMaxBytes);
+}
+
+void XPLMSetDatab(XPLMDataRef inDataRef, void* inValue, int inOffset, int inLength) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (!ref || !ref->writable || !ref->write_data) return;
+    ref->write_data(ref->write_refcon, inValue, inOffset, inLength);
+}
+
+XPLMDataRef XPLMRegisterDataAccessor(
+        const char* inDataName, XPLMDataTypeID inDataType, int inIsWritable,
+        XPLMGetDatai_f inReadInt, XPLMSetDatai_f inWriteInt,
+        XPLMGetDataf_f inReadFloat, XPLMSetDataf_f inWriteFloat,
+        XPLMGetDatad_f inReadDouble, XPLMSetDatad_f inWriteDouble,
+        XPLMGetDatavi_f inReadIntArray, XPLMSetDatavi_f inWriteIntArray,
+        XPLMGetDatavf_f inReadFloatArray, XPLMSetDatavf_f inWriteFloatArray,
+        XPLMGetDatab_f inReadData, XPLMSetDatab_f inWriteData,
+        void* inReadRefcon, void* inWriteRefcon) {
+    std::unique_ptr<StubDataRef> ref(new StubDataRef());
+    ref->name = inDataName;
+    ref->type = inDataType;
+    ref->writable = inIsWritable != 0;
+    ref->read_int = inReadInt;
+    ref->write_int = inWriteInt;
+    ref->read_float = inReadFloat;
+    ref->write_float = inWriteFloat;
+    ref->read_double = inReadDouble;
+    ref->write_double = inWriteDouble;
+    ref->read_int_array = inReadIntArray;
+    ref->write_int_array = inWriteIntArray;
+    ref->read_float_array = inReadFloatArray;
+    ref->write_float_array = inWriteFloatArray;
+    ref->read_data = inReadData;
+    ref->write_data = inWriteData;
+    ref->read_refcon = inReadRefcon;
+    ref->write_refcon = inWriteRefcon;
+    StubDataRef* handle = ref.get();
+    g_datarefs[inDataName] = std::move(ref);
+    g_datarefs_added = true;
+    return handle;
+}
+
+void XPLMUnregisterDataAccessor(XPLMDataRef inDataRef) {
+    StubDataRef* ref = AsStub(inDataRef);
+    if (ref) {
+        g_datarefs.erase(ref->name);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Flight loops
+
+struct StubFlightLoop {
+    XPLMFlightLoopPhaseType phase;
+    XPLMFlightLoop_f callback;
+    void* refcon;
+    bool scheduled;
+    bool relative_to_now;
+    float interval;         // > 0 seconds, < 0 frames
+    float due_time;
+    long due_frame;
+    float last_call_time;
+};
+
+static std::vector<std::unique_ptr<StubFlightLoop>> g_flight_loops;
+static float g_elapsed_time = 0.0f;
+static float g_frame_dt = 0.0f;
+static long g_frame_counter = 0;
+static long g_flight_loop_calls = 0;
+
+static void ArmFlightLoop(StubFlightLoop* loop, float interval, float from_time) {
+    loop->interval = interval;
+    loop->scheduled = interval != 0.0f;
+    if (interval > 0.0f) {
+        loop->due_time = from_time + interval;
+    } else if (interval < 0.0f) {
+        loop->due_frame = g_frame_counter + (long)(-interval);
+    }
+}
+
+XPLMFlightLoopID XPLMCreateFlightLoop(XPLMCreateFlightLoop_t* inParams) {
+    std::unique_ptr<StubFlightLoop> loop(new StubFlightLoop());
+    loop->phase = inParams->phase;
+    loop->callback = inParams->callbackFunc;
+    loop->refcon = inParams->refcon;
+    loop->scheduled = false;
+    loop->last_call_time = g_elapsed_time;
+    StubFlightLoop* handle = loop.get();
+    g_flight_loops.push_back(std::move(loop));
+    return handle;
+}
+
+void XPLMDestroyFlightLoop(XPLMFlightLoopID inFlightLoopID) {
+    for (size_t i = 0; i < g_flight_loops.size(); i++) {
+        if (g_flight_loops[i].get() == inFlightLoopID) {
+            g_flight_loops.erase(g_flight_loops.begin() + i);
+            return;
+        }
+    }
+}
+
+void XPLMScheduleFlightLoop(XPLMFlightLoopID inFlightLoopID, float inInterval, int inRelativeToNow) {
+    StubFlightLoop* loop = static_cast<StubFlightLoop*>(inFlightLoopID);
+    float from_time = inRelativeToNow ? g_elapsed_time : loop->last_call_time;
+    ArmFlightLoop(loop, inInterval, from_time);
+}
+
+float XPLMGetElapsedTime(void) {
+    return g_elapsed_time;
+}
+
+int XPLMGetCycleNumber(void) {
+    return (int)g_frame_counter;
+}
+
+void StubBeginFrame(float dt) {
+    g_frame_counter++;
+    g_frame_dt = dt;
+    g_elapsed_time += dt;
+
+    // Announce the datarefs added since the last frame, with the new total
+    if (g_datarefs_added && g_message_handler && XPLMIsFeatureEnabled("XPLM_WANTS_DATAREF_NOTIFICATIONS")) {
+        g_datarefs_added = false;
+        g_message_handler(XPLM_PLUGIN_XPLANE, XPLM_MSG_DATAREFS_ADDED, (void*)(intptr_t)g_datarefs.size());
+    }
+}
+
+// Invoke loop i and re-arm it with the interval it returns
+static void CallFlightLoop(size_t i) {
+    StubFlightLoop* loop = g_flight_loops[i].get();
+    float since_last = g_elapsed_time - loop->last_call_time;
+    loop->last_call_time = g_elapsed_time;
+    g_flight_loop_calls++;
+    float next = loop->callback(since_last, g_frame_dt, (int)g_frame_counter, loop->refcon);
+
+    // The callback may have destroyed itself
+    if (i < g_flight_loops.size() && g_flight_loops[i].get() == loop) {
+        ArmFlightLoop(loop, next, g_elapsed_time);
+    }
+}
+
+void StubRunFlightLoops(XPLMFlightLoopPhaseType phase) {
+    // Callbacks may create or destroy loops, so index rather than iterate
+    for (size_t i = 0; i < g_flight_loops.size(); i++) {
+        StubFlightLoop* loop = g_flight_loops[i].get();
+        if (loop->phase != phase || !loop->scheduled) {
+            continue;
+        }
+        bool due = (loop->interval > 0.0f) ? g_elapsed_time >= loop->due_time : g_frame_counter >= loop->due_frame;
+        if (due) {
+            CallFlightLoop(i);
+        }
+    }
+}
+
+void StubForceFlightLoops(XPLMFlightLoopPhaseType phase) {
+    for (size_t i = 0; i < g_flight_loops.size(); i++) {
+        if (g_flight_loops[i]->phase == phase) {
+            CallFlightLoop(i);
+        }
+    }
+}
+
+long StubFlightLoopCallCount(void) {
+    return g_flight_loop_calls;
+}
+
+float StubElapsedTime(void) {
+    return g_elapsed_time;
+}
+
+// ---------------------------------------------------------------------------
+// Widgets
+
+struct StubWidget {
+    std::string descriptor;
+    bool visible;
+    StubWidget* container;
+    XPWidgetClass widget_class;
+    std::map<XPWidgetPropertyID, intptr_t> properties;
+    std::vector<XPWidgetFunc_t> callbacks;
+};
+
+static std::vector<std::unique_ptr<StubWidget>> g_widgets;
+
+static StubWidget* AsWidget(XPWidgetID widget) {
+    return static_cast<StubWidget*>(widget);
+}
+
+// Deliver a message to a widget and then up its container chain until handled
+static void SendUpChain(StubWidget* widget, XPWidgetMessage message, intptr_t param1, intptr_t param2) {
+    for (StubWidget* target = widget; target; target = target->container) {
+        for (XPWidgetFunc_t callback : target->callbacks) {
+            if (callback(message, target, param1, param2)) {
+                return;
+            }
+        }
+    }
+}
+
+XPWidgetID XPCreateWidget(int inLeft, int inTop, int inRight, int inBottom, int inVisible,
+                          const char* inDescriptor, int inIsRoot, XPWidgetID inContainer,
+                          XPWidgetClass inClass) {
+    (void)inLeft;
+    (void)inTop;
+    (void)inRight;
+    (void)inBottom;
+    (void)inIsRoot;
+    std::unique_ptr<StubWidget> widget(new StubWidget());
+    widget->descriptor = inDescriptor ? inDescriptor : "";
+    widget->visible = inVisible != 0;
+    widget->container = AsWidget(inContainer);
+    widget->widget_class = inClass;
+    StubWidget* handle = widget.get();
+    g_widgets.push_back(std::move(widget));
+    return handle;
+}
+
+void XPDestroyWidget(XPWidgetID inWidget, int inDestroyChildren) {
+    StubWidget* widget = AsWidget(inWidget);
+    for (size_t i = 0; i < g_widgets.size();) {
+        StubWidget* candidate = g_widgets[i].get();
+        bool child = inDestroyChildren && candidate->container == widget;
+        if (candidate == widget || child) {
+            g_widgets.erase(g_widgets.begin() + i);
+        } else {
+            if (candidate->container == widget) {
+                candidate->container = nullptr;
+            }
+            i++;
+        }
+    }
+}
+
+void XPShowWidget(XPWidgetID inWidget) {
+    AsWidget(inWidget)->visible = true;
+}
+
+void XPHideWidget(XPWidgetID inWidget) {
+    AsWidget(inWidget)->visible = false;
+}
+
+int XPIsWidgetVisible(XPWidgetID inWidget) {
+    for (StubWidget* widget = AsWidget(inWidget); widget; widget = widget->container) {
+        if (!widget->visible) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void XPSetWidgetProperty(XPWidgetID inWidget, XPWidgetPropertyID inProperty, intptr_t inValue) {
+    AsWidget(inWidget)->properties[inProperty] = inValue;
+}
+
+intptr_t XPGetWidgetProperty(XPWidgetID inWidget, XPWidgetPropertyID inProperty, int* inExists) {
+    StubWidget* widget = AsWidget(inWidget);
+    auto it = widget->properties.find(inProperty);
+    if (inExists) {
+        *inExists = it != widget->properties.end();
+    }
+    return (it != widget->properties.end()) ? it->second : 0;
+}
+
+void XPAddWidgetCallback(XPWidgetID inWidget, XPWidgetFunc_t inNewCallback) {
+    AsWidget(inWidget)->callbacks.insert(AsWidget(inWidget)->callbacks.begin(), inNewCallback);
+}
+
+void XPSetWidgetDescriptor(XPWidgetID inWidget, const char* inDescriptor) {
+    AsWidget(inWidget)->descriptor = inDescriptor ? inDescriptor : "";
+}
+
+int XPGetWidgetDescriptor(XPWidgetID inWidget, char* outDescriptor, int inMaxDescLength) {
+    const std::string& descriptor = AsWidget(inWidget)->descriptor;
+    if (outDescriptor && inMaxDescLength > 0) {
+        snprintf(outDescriptor, inMaxDescLength, "%s", descriptor.c_str());
+    }
+    return (int)descriptor.size();
+}
+
+XPWidgetID StubFindWidget(const char* descriptor) {
+    for (const auto& widget : g_widgets) {
+        if (widget->descriptor == descriptor) {
+            return widget.get();
+        }
+    }
+    return nullptr;
+}
+
+XPWidgetID StubFindWidgetOfClass(XPWidgetClass widget_class) {
+    for (const auto& widget : g_widgets) {
+        if (widget->widget_class == widget_class) {
+            return widget.get();
+        }
+    }
+    return nullptr;
+}
+
+void StubPushButton(XPWidgetID button) {
+    if (button) {
+        SendUpChain(AsWidget(button), xpMsg_PushButtonPressed, (intptr_t)button, 0);
+    }
+}
+
+void StubSetSlider(XPWidgetID slider, int position) {
+    if (slider) {
+        XPSetWidgetProperty(slider, xpProperty_ScrollBarSliderPosition, position);
+        SendUpChain(AsWidget(slider), xpMsg_ScrollBarSliderPositionChanged, (intptr_t)slider, 0);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Menus
+
+struct StubMenu {
+    std::string name;
+    XPLMMenuHandler_f handler;
+    void* menu_ref;
+    std::vector<std::pair<std::string, void*>> items;
+};
+
+static std::vector<std::unique_ptr<StubMenu>> g_menus;
+static StubMenu g_plugins_menu = { "Plugins", nullptr, nullptr, {} };
+
+XPLMMenuID XPLMFindPluginsMenu(void) {
+    return &g_plugins_menu;
+}
+
+XPLMMenuID XPLMCreateMenu(const char* inName, XPLMMenuID inParentMenu, int inParentItem,
+                          XPLMMenuHandler_f inHandler, void* inMenuRef) {
+    (void)inParentMenu;
+    (void)inParentItem;
+    std::unique_ptr<StubMenu> menu(new StubMenu());
+    menu->name = inName;
+    menu->handler = inHandler;
+    menu->menu_ref = inMenuRef;
+    StubMenu* handle = menu.get();
+    g_menus.push_back(std::move(menu));
+    return handle;
+}
+
+int XPLMAppendMenuItem(XPLMMenuID inMenu, const char* inItemName, void* inItemRef, int inDeprecatedAndIgnored) {
+    (void)inDeprecatedAndIgnored;
+    StubMenu* menu = static_cast<StubMenu*>(inMenu);
+    menu->items.push_back(std::make_pair(std::string(inItemName), inItemRef));
+    return (int)menu->items.size() - 1;
+}
+
+bool StubSelectMenuItem(const char* item_name) {
+    for (const auto& menu : g_menus) {
+        for (const auto& item : menu->items) {
+            if (item.first == item_name && menu->handler) {
+                menu->handler(menu->menu_ref, item.second);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------
+// Commands
+
+struct StubCommandHandler {
+    XPLMCommandCallback_f callback;
+    int before;
+    void* refcon;
+};
+
+struct StubCommand {
+    std::string name;
+    std::vector<StubCommandHandler> handlers;
+};
+
+static std::map<std::string, std::unique_ptr<StubCommand>> g_commands;
+
+XPLMCommandRef XPLMFindCommand(const char* inName) {
+    auto it = g_commands.find(inName);
+    return (it == g_commands.end()) ? nullptr : it->second.get();
+}
+
+XPLMCommandRef XPLMCreateCommand(const char* inName, const char* inDescription) {
+    (void)inDescription;
+    XPLMCommandRef existing = XPLMFindCommand(inName);
+    if (existing) {
+        return existing;
+    }
+    std::unique_ptr<StubCommand> command(new StubCommand());
+    command->name = inName;
+    StubCommand* handle = command.get();
+    g_commands[inName] = std::move(command);
+    return handle;
+}
+
+void XPLMRegisterCommandHandler(XPLMCommandRef inComand, XPLMCommandCallback_f inHandler, int inBefore, void* inRefcon) {
+    StubCommandHandler handler = { inHandler, inBefore, inRefcon };
+    static_cast<StubCommand*>(inComand)->handlers.push_back(handler);
+}
+
+void XPLMUnregisterCommandHandler(XPLMCommandRef inComand, XPLMCommandCallback_f inHandler, int inBefore, void* inRefcon) {
+    std::vector<StubCommandHandler>& handlers = static_cast<StubCommand*>(inComand)->handlers;
+    for (size_t i = 0; i < handlers.size(); i++) {
+        if (handlers[i].callback == inHandler && handlers[i].before == inBefore && handlers[i].refcon == inRefcon) {
+            handlers.erase(handlers.begin() + i);
+            return;
+        }
+    }
+}
+
+static void DispatchCommand(StubCommand* command, XPLMCommandPhase phase) {
+    for (const StubCommandHandler& handler : command->handlers) {
+        if (!handler.callback(command, phase, handler.refcon)) {
+            return;
+        }
+    }
+}
+
+void XPLMCommandOnce(XPLMCommandRef inCommand) {
+    StubCommand* command = static_cast<StubCommand*>(inCommand);
+    DispatchCommand(command, xplm_CommandBegin);
+    DispatchCommand(command, xplm_CommandEnd);
+}
+
+bool StubRunCommand(const char* name, XPLMCommandPhase phase) {
+    StubCommand* command = static_cast<StubCommand*>(XPLMFindCommand(name));
+    if (!command) {
+        return false;
+    }
+    DispatchCommand(command, phase);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Utilities
+
+// Features the stub implements; the rest report as missing
+static const char* const STUB_FEATURES[] = { "XPLM_WANTS_DATAREF_NOTIFICATIONS" };
+static std::set<std::string> g_enabled_features;
+
+int XPLMHasFeature(const char* inFeature) {
+    for (const char* feature : STUB_FEATURES) {
+        if (!strcmp(feature, inFeature)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void XPLMEnableFeature(const char* inFeature, int inEnable) {
+    if (!XPLMHasFeature(inFeature)) {
+        return;
+    }
+    if (inEnable) {
+        g_enabled_features.insert(inFeature);
+    } else {
+        g_enabled_features.erase(inFeature);
+    }
+}
+
+int XPLMIsFeatureEnabled(const char* inFeature) {
+    return g_enabled_features.count(inFeature) ? 1 : 0;
+}
+
+
+void XPLMReloadPlugins(void) {
+}
+
+void XPLMDebugString(const char* inString) {
+    fputs(inString, stderr);
+}
+
+static std::string g_system_path = "./";
+
+void StubSetSystemPath(const char* path) {
+    g_system_path = path;
+    if (g_system_path.empty() || g_system_path.back() != '/') {
+        g_system_path += '/';
+    }
+}
+
+void XPLMGetSystemPath(char* outSystemPath) {
+    strcpy(outSystemPath, g_system_path.c_str());
+}
+
+static std::string g_aircraft_path;
+
+void StubSetAircraftPath(const char* path) {
+    g_aircraft_path = path;
+}
+
+void XPLMGetNthAircraftModel(int inIndex, char* outFileName, char* outPath) {
+    const char* separator = strrchr(g_aircraft_path.c_str(), '/');
+    const char* file_name = separator ? separator + 1 : g_aircraft_path.c_str();
+    strcpy(outFileName, inIndex == 0 ? file_name : "");
+    strcpy(outPath, inIndex == 0 ? g_aircraft_path.c_str() : "");
+}
+
+const char* XPLMGetDirectorySeparator(void) {
+    return "/";
+}
@@ -0,0 +1,82 @@
+#ifndef XPLM_STUB_H
+#define XPLM_STUB_H
+
+#include "XPLMDataAccess.h"
+#include "XPLMDefs.h"
+#include "XPLMProcessing.h"
+#include "XPLMUtilities.h"
+#include "XPWidgetDefs.h"
+
+// Host-side control of the local XPLM/XPWidgets stub. The stub implements
+// the subset of the SDK the plugin uses, so the plugin can be loaded and
+// stepped by a standalone executable instead of X-Plane.
+
+// Create a sim-owned dataref. Array types hold array_size elements.
+void StubDefineDataRef(const char* name, XPLMDataTypeID type, int array_size, bool writable);
+
+// Hide a dataref from XPLMFindDataRef, as if its publisher had not loaded
+// yet, or publish it again. Its storage stays accessible to the host.
+void StubHideDataRef(const char* name);
+void StubPublishDataRef(const char* name);
+
+// Receiver of XPLM messages from the stub, i.e. the plugin's
+// XPluginReceiveMessage. Once it enables XPLM_WANTS_DATAREF_NOTIFICATIONS,
+// datarefs defined, registered or published again are announced with one
+// XPLM_MSG_DATAREFS_ADDED at the start of the next frame, as X-Plane
+// coalesces them.
+typedef void (*StubMessageHandler_f)(XPLMPluginID inFrom, int inMessage, void* inParam);
+void StubSetMessageHandler(StubMessageHandler_f handler);
+
+// Direct access to the storage of a sim-owned dataref (nullptr if the
+// dataref was not defined with that type)
+float* StubFloatData(const char* name);
+int* StubIntData(const char* name);
+
+// Read or write any dataref by name, including plugin-published ones
+float StubGetFloat(const char* name);
+int StubGetInt(const char* name);
+void StubSetFloat(const char* name, float value);
+void StubSetInt(const char* name, int value);
+
+// Start a new sim frame lasting dt seconds
+void StubBeginFrame(float dt);
+
+// Run the flight loops of one phase that are due in the current frame
+void StubRunFlightLoops(XPLMFlightLoopPhaseType phase);
+
+// Run every flight loop of one phase now, scheduled or not (for
+// benchmarking the callback itself)
+void StubForceFlightLoops(XPLMFlightLoopPhaseType phase);
+
+// Number of flight loop callbacks invoked so far
+long StubFlightLoopCallCount(void);
+
+// Current stub clock (seconds)
+float StubElapsedTime(void);
+
+// Find the first widget with the given descriptor
+XPWidgetID StubFindWidget(const char* descriptor);
+
+// Find the first widget of the given class
+XPWidgetID StubFindWidgetOfClass(XPWidgetClass widget_class);
+
+// Send a push-button press for a button widget up its container chain
+void StubPushButton(XPWidgetID button);
+
+// Move a scroll bar and notify its container chain
+void StubSetSlider(XPWidgetID slider, int position);
+
+// Invoke a menu item handler by item name
+bool StubSelectMenuItem(const char* item_name);
+
+// Run a command's handlers for one phase (begin, continue or end)
+bool StubRunCommand(const char* name, XPLMCommandPhase phase);
+
+// Directory returned by XPLMGetSystemPath (default "./")
+void StubSetSystemPath(const char* path);
+
+// Full path of the user aircraft's .acf returned by XPLMGetNthAircraftModel
+// (default none)
+void StubSetAircraftPath(const char* path);
+
+#endif // XPLM_STUB_H